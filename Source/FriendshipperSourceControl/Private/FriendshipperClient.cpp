@@ -1,5 +1,6 @@
 ﻿#include "FriendshipperClient.h"
 
+#include "FriendshipperSourceControlCommand.h"
 #include "HttpManager.h"
 #include "HttpModule.h"
 #include "ISourceControlModule.h"
@@ -27,6 +28,13 @@ static bool ProcessRequestAndWait(const TSharedRef<IHttpRequest>& Request, FFrie
 		double LastTime = FPlatformTime::Seconds();
 		while (Request->GetStatus() == EHttpRequestStatus::Processing && !IsEngineExitRequested())
 		{
+			// The command this request is made for was cancelled, nobody will look at the response
+			if (FFriendshipperSourceControlCommand::IsCurrentCommandCanceled())
+			{
+				Request->CancelRequest();
+				return false;
+			}
+
 			const double AppTime = FPlatformTime::Seconds();
 			if (IsInGameThread())
 			{
@@ -35,9 +43,13 @@ static bool ProcessRequestAndWait(const TSharedRef<IHttpRequest>& Request, FFrie
 			}
 			FPlatformProcess::Sleep(0.1);
 		}
+		return true;
 	};
 
-	WaitForRequest();
+	if (!WaitForRequest())
+	{
+		return false;
+	}
 
 	int32 NumNonceAuthRetries = 1;
 
@@ -47,11 +59,10 @@ static bool ProcessRequestAndWait(const TSharedRef<IHttpRequest>& Request, FFrie
 
 		Client.RefreshNonce();
 		Client.AddNonceHeader(Request);
-		if (!Request->ProcessRequest())
+		if (!Request->ProcessRequest() || !WaitForRequest())
 		{
 			return false;
 		}
-		WaitForRequest();
 	}
 
 	return true;
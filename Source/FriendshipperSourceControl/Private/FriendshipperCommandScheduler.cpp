@@ -0,0 +1,163 @@
+// Copyright The Believer Company. All Rights Reserved.
+
+#include "FriendshipperCommandScheduler.h"
+
+#include "FriendshipperSourceControlCommand.h"
+
+void FFriendshipperCommandScheduler::FPathSet::Add(const FCommandFiles& InFiles)
+{
+	++NumCommands;
+	NumExclusive += InFiles.bExclusive ? 1 : 0;
+
+	const FFriendshipperPathTable& PathTable = FFriendshipperPathTable::Get();
+	for (const FFriendshipperPathId Path : InFiles.Paths)
+	{
+		++Paths.FindOrAdd(Path);
+		for (FFriendshipperPathId Parent = PathTable.GetParent(Path); Parent.IsValid(); Parent = PathTable.GetParent(Parent))
+		{
+			++Ancestors.FindOrAdd(Parent);
+		}
+	}
+}
+
+void FFriendshipperCommandScheduler::FPathSet::Remove(const FCommandFiles& InFiles)
+{
+	--NumCommands;
+	NumExclusive -= InFiles.bExclusive ? 1 : 0;
+
+	auto Release = [](TMap<FFriendshipperPathId, int32>& InOutCounts, const FFriendshipperPathId InPath)
+	{
+		int32& Count = InOutCounts.FindChecked(InPath);
+		if (--Count == 0)
+		{
+			InOutCounts.Remove(InPath);
+		}
+	};
+
+	const FFriendshipperPathTable& PathTable = FFriendshipperPathTable::Get();
+	for (const FFriendshipperPathId Path : InFiles.Paths)
+	{
+		Release(Paths, Path);
+		for (FFriendshipperPathId Parent = PathTable.GetParent(Path); Parent.IsValid(); Parent = PathTable.GetParent(Parent))
+		{
+			Release(Ancestors, Parent);
+		}
+	}
+}
+
+bool FFriendshipperCommandScheduler::FPathSet::Overlaps(const FCommandFiles& InFiles) const
+{
+	if (InFiles.bExclusive)
+	{
+		return NumCommands > 0;
+	}
+	if (NumExclusive > 0)
+	{
+		return true;
+	}
+
+	const FFriendshipperPathTable& PathTable = FFriendshipperPathTable::Get();
+	for (const FFriendshipperPathId Path : InFiles.Paths)
+	{
+		// The same file, a file under this directory, or a directory above this file
+		if (Paths.Contains(Path) || Ancestors.Contains(Path))
+		{
+			return true;
+		}
+		for (FFriendshipperPathId Parent = PathTable.GetParent(Path); Parent.IsValid(); Parent = PathTable.GetParent(Parent))
+		{
+			if (Paths.Contains(Parent))
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool FFriendshipperCommandScheduler::GetCommandFiles(const FFriendshipperSourceControlCommand& InCommand, FCommandFiles& OutFiles)
+{
+	if (InCommand.Files.IsEmpty())
+	{
+		// Whole project status refreshes don't need any ordering
+		if (InCommand.Operation->GetName() == "UpdateStatus")
+		{
+			return false;
+		}
+		OutFiles.bExclusive = true;
+		return true;
+	}
+
+	FFriendshipperPathTable& PathTable = FFriendshipperPathTable::Get();
+	OutFiles.Paths.Reserve(InCommand.Files.Num());
+	for (const FString& File : InCommand.Files)
+	{
+		// Directories must be interned without their trailing slash for the files under them to conflict with them
+		const FFriendshipperPathId Path = PathTable.Intern(FFriendshipperPathTable::TrimTrailingSlashes(File));
+		checkSlow(!Path.IsValid() || !PathTable.GetName(Path).IsEmpty());
+		OutFiles.Paths.AddUnique(Path);
+	}
+	return true;
+}
+
+bool FFriendshipperCommandScheduler::Submit(FFriendshipperSourceControlCommand& InCommand, const FStartCommand InStart)
+{
+	FCommandFiles Files;
+	if (!GetCommandFiles(InCommand, Files))
+	{
+		InStart(InCommand);
+		return true;
+	}
+
+	// Queue it behind the waiting commands, it starts right away if none of them or of the running ones conflict
+	CommandFiles.Add(&InCommand, MoveTemp(Files));
+	Waiting.Add(&InCommand);
+	StartWaiting(InStart);
+	return !Waiting.Contains(&InCommand);
+}
+
+void FFriendshipperCommandScheduler::Complete(FFriendshipperSourceControlCommand& InCommand, const FStartCommand InStart)
+{
+	FCommandFiles Files;
+	if (!CommandFiles.RemoveAndCopyValue(&InCommand, Files))
+	{
+		return;
+	}
+
+	Running.Remove(Files);
+	StartWaiting(InStart);
+}
+
+bool FFriendshipperCommandScheduler::RemoveWaiting(FFriendshipperSourceControlCommand& InCommand, const FStartCommand InStart)
+{
+	if (Waiting.RemoveSingle(&InCommand) == 0)
+	{
+		return false;
+	}
+
+	CommandFiles.Remove(&InCommand);
+	StartWaiting(InStart);
+	return true;
+}
+
+void FFriendshipperCommandScheduler::StartWaiting(const FStartCommand InStart)
+{
+	// Files of the commands still waiting before the one being considered
+	FPathSet Ahead;
+	for (int32 Index = 0; Index < Waiting.Num();)
+	{
+		FFriendshipperSourceControlCommand* Command = Waiting[Index];
+		const FCommandFiles& Files = CommandFiles.FindChecked(Command);
+		if (!Running.Overlaps(Files) && !Ahead.Overlaps(Files))
+		{
+			Running.Add(Files);
+			Waiting.RemoveAt(Index);
+			InStart(*Command);
+		}
+		else
+		{
+			Ahead.Add(Files);
+			++Index;
+		}
+	}
+}
@@ -0,0 +1,72 @@
+// Copyright The Believer Company. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FriendshipperPathTable.h"
+
+class FFriendshipperSourceControlCommand;
+
+/**
+ * Decides when issued commands can start, so that commands on the same files run one after the other in submission
+ * order while commands on disjoint files run in parallel.
+ *
+ * A command conflicts with another if one of its files is, or is under, a file or directory of the other. Commands
+ * without files work on the whole repository and conflict with every other command, except whole project status
+ * refreshes: they only read, and never wait or hold anything back. Only used from the game thread.
+ */
+class FFriendshipperCommandScheduler
+{
+public:
+	using FStartCommand = TFunctionRef<void(FFriendshipperSourceControlCommand&)>;
+
+	/** Start a command through InStart if nothing running or waiting conflicts with it, else hold it back. Returns true if started. */
+	bool Submit(FFriendshipperSourceControlCommand& InCommand, FStartCommand InStart);
+
+	/** A command started by the scheduler completed, start the commands it was holding back */
+	void Complete(FFriendshipperSourceControlCommand& InCommand, FStartCommand InStart);
+
+	/** Forget a command that was held back, eg. because it was cancelled. Returns false if it isn't waiting. */
+	bool RemoveWaiting(FFriendshipperSourceControlCommand& InCommand, FStartCommand InStart);
+
+	int32 NumWaiting() const
+	{
+		return Waiting.Num();
+	}
+
+private:
+	struct FCommandFiles
+	{
+		TArray<FFriendshipperPathId> Paths;
+		/** Works on the whole repository */
+		bool bExclusive = false;
+	};
+
+	/** Files of a group of commands, with the directories above them to find files under a given directory */
+	struct FPathSet
+	{
+		TMap<FFriendshipperPathId, int32> Paths;
+		TMap<FFriendshipperPathId, int32> Ancestors;
+		int32 NumCommands = 0;
+		int32 NumExclusive = 0;
+
+		void Add(const FCommandFiles& InFiles);
+		void Remove(const FCommandFiles& InFiles);
+		bool Overlaps(const FCommandFiles& InFiles) const;
+	};
+
+	/** Files of a command, false if it doesn't take part in the scheduling */
+	static bool GetCommandFiles(const FFriendshipperSourceControlCommand& InCommand, FCommandFiles& OutFiles);
+
+	/** Start the waiting commands that no longer conflict with running ones or with waiting ones submitted before them */
+	void StartWaiting(FStartCommand InStart);
+
+	/** Files of the commands started by the scheduler and not completed yet */
+	FPathSet Running;
+
+	/** Commands held back, in submission order */
+	TArray<FFriendshipperSourceControlCommand*> Waiting;
+
+	/** Files of the running and waiting commands */
+	TMap<const FFriendshipperSourceControlCommand*, FCommandFiles> CommandFiles;
+};
@@ -0,0 +1,523 @@
+// Copyright The Believer Company. All Rights Reserved.
+
+#include "FriendshipperGitAttributes.h"
+
+#include "Algo/Sort.h"
+#include "FriendshipperSourceControlUtils.h"
+#include "HAL/FileManager.h"
+#include "ISourceControlModule.h"
+#include "Misc/Crc.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PathViews.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+const TCHAR* AttributesFileName = TEXT(".gitattributes");
+const TCHAR* LockableAttribute = TEXT("lockable");
+
+uint32 HashKey(const FStringView InKey)
+{
+	return FCrc::Strihash_DEPRECATED(InKey.Len(), InKey.GetData());
+}
+
+bool HasWildcards(const FStringView InPattern)
+{
+	for (const TCHAR Char : InPattern)
+	{
+		if (Char == TEXT('*') || Char == TEXT('?') || Char == TEXT('[') || Char == TEXT('\\'))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/** Match InChar against the bracket expression starting at InPattern[InStart]. Returns false if the expression is not terminated. */
+bool MatchBracket(const FStringView InPattern, const int32 InStart, const TCHAR InChar, int32& OutEnd, bool& bOutMatch)
+{
+	int32 Index = InStart + 1;
+	bool bNegate = false;
+	if (Index < InPattern.Len() && (InPattern[Index] == TEXT('!') || InPattern[Index] == TEXT('^')))
+	{
+		bNegate = true;
+		++Index;
+	}
+
+	const TCHAR Char = FChar::ToLower(InChar);
+	bool bMatch = false;
+	bool bFirst = true;
+	while (Index < InPattern.Len() && (bFirst || InPattern[Index] != TEXT(']')))
+	{
+		bFirst = false;
+
+		TCHAR Low = InPattern[Index];
+		if (Low == TEXT('\\') && Index + 1 < InPattern.Len())
+		{
+			Low = InPattern[++Index];
+		}
+		++Index;
+
+		TCHAR High = Low;
+		if (Index + 1 < InPattern.Len() && InPattern[Index] == TEXT('-') && InPattern[Index + 1] != TEXT(']'))
+		{
+			High = InPattern[Index + 1];
+			Index += 2;
+		}
+
+		if (Char >= FChar::ToLower(Low) && Char <= FChar::ToLower(High))
+		{
+			bMatch = true;
+		}
+	}
+
+	if (Index >= InPattern.Len())
+	{
+		return false;
+	}
+
+	OutEnd = Index + 1;
+	bOutMatch = InChar != TEXT('/') && bMatch != bNegate;
+	return true;
+}
+
+/** Case insensitive wildmatch, with git's pathname rules: wildcards don't match '/', except for "**" segments */
+bool WildMatch(const FStringView InPattern, const FStringView InText)
+{
+	int32 P = 0;
+	int32 T = 0;
+	while (P < InPattern.Len())
+	{
+		const TCHAR Char = InPattern[P];
+		if (Char == TEXT('*'))
+		{
+			int32 End = P;
+			while (End < InPattern.Len() && InPattern[End] == TEXT('*'))
+			{
+				++End;
+			}
+
+			if (End - P > 1 && (P == 0 || InPattern[P - 1] == TEXT('/')) && (End == InPattern.Len() || InPattern[End] == TEXT('/')))
+			{
+				// A trailing "**" matches everything left
+				if (End == InPattern.Len())
+				{
+					return true;
+				}
+
+				// "**/" matches zero or more directories
+				const FStringView Rest = InPattern.RightChop(End + 1);
+				for (int32 Start = T;;)
+				{
+					if (WildMatch(Rest, InText.RightChop(Start)))
+					{
+						return true;
+					}
+					int32 Slash = INDEX_NONE;
+					if (!InText.RightChop(Start).FindChar(TEXT('/'), Slash))
+					{
+						return false;
+					}
+					Start += Slash + 1;
+				}
+			}
+
+			// Anything else behaves as a single star, which stops at directory separators
+			const FStringView Rest = InPattern.RightChop(End);
+			for (int32 Start = T; Start <= InText.Len(); ++Start)
+			{
+				if (WildMatch(Rest, InText.RightChop(Start)))
+				{
+					return true;
+				}
+				if (Start < InText.Len() && InText[Start] == TEXT('/'))
+				{
+					return false;
+				}
+			}
+			return false;
+		}
+
+		if (T >= InText.Len())
+		{
+			return false;
+		}
+
+		if (Char == TEXT('?'))
+		{
+			if (InText[T] == TEXT('/'))
+			{
+				return false;
+			}
+			++P;
+			++T;
+			continue;
+		}
+
+		if (Char == TEXT('['))
+		{
+			int32 End = 0;
+			bool bMatch = false;
+			if (MatchBracket(InPattern, P, InText[T], End, bMatch))
+			{
+				if (!bMatch)
+				{
+					return false;
+				}
+				P = End;
+				++T;
+				continue;
+			}
+			// Not terminated, so a literal '['
+		}
+
+		TCHAR Literal = Char;
+		if (Char == TEXT('\\') && P + 1 < InPattern.Len())
+		{
+			Literal = InPattern[++P];
+		}
+		if (FChar::ToLower(Literal) != FChar::ToLower(InText[T]))
+		{
+			return false;
+		}
+		++P;
+		++T;
+	}
+	return T == InText.Len();
+}
+
+/** Split an attributes line in a pattern and its attributes. Quoted patterns are unquoted. */
+bool SplitLine(const FString& InLine, FString& OutPattern, TArray<FString>& OutAttributes)
+{
+	FString Rest;
+	if (InLine.StartsWith(TEXT("\"")))
+	{
+		int32 Index = 1;
+		for (; Index < InLine.Len() && InLine[Index] != TEXT('"'); ++Index)
+		{
+			if (InLine[Index] == TEXT('\\') && Index + 1 < InLine.Len())
+			{
+				++Index;
+			}
+			OutPattern.AppendChar(InLine[Index]);
+		}
+		if (Index >= InLine.Len())
+		{
+			return false;
+		}
+		Rest = InLine.RightChop(Index + 1);
+	}
+	else
+	{
+		int32 Index = 0;
+		while (Index < InLine.Len() && !FChar::IsWhitespace(InLine[Index]))
+		{
+			++Index;
+		}
+		OutPattern = InLine.Left(Index);
+		Rest = InLine.RightChop(Index);
+	}
+
+	Rest.ParseIntoArrayWS(OutAttributes);
+	return !OutPattern.IsEmpty();
+}
+} // namespace
+
+TSharedRef<const FFriendshipperGitAttributes, ESPMode::ThreadSafe> FFriendshipperGitAttributes::Load(const FString& InPathToGitBinary, const FString& InRepositoryRoot)
+{
+	TSharedRef<FFriendshipperGitAttributes, ESPMode::ThreadSafe> Attributes = MakeShared<FFriendshipperGitAttributes, ESPMode::ThreadSafe>();
+	Attributes->RepositoryRoot = InRepositoryRoot;
+	if (!Attributes->RepositoryRoot.EndsWith(TEXT("/")))
+	{
+		Attributes->RepositoryRoot.AppendChar(TEXT('/'));
+	}
+
+	// Ask git for the attributes files it tracks rather than walking the whole work tree
+	IFileManager& FileManager = IFileManager::Get();
+	TArray<FString> AttributesFiles;
+	TArray<FString> RelativeFiles;
+	TArray<FString> ErrorMessages;
+	const TArray<FString> Pathspecs{ AttributesFileName, FString(TEXT("*/")) + AttributesFileName };
+	if (FriendshipperSourceControlUtils::RunCommand(TEXT("ls-files"), InPathToGitBinary, Attributes->RepositoryRoot, { TEXT("--") }, Pathspecs, RelativeFiles, ErrorMessages))
+	{
+		AttributesFiles = FriendshipperSourceControlUtils::AbsoluteFilenames(RelativeFiles, Attributes->RepositoryRoot);
+	}
+	else
+	{
+		UE_LOG(LogSourceControl, Warning, TEXT("Failed to list the attributes files of %s, only the root one is used: %s"), *Attributes->RepositoryRoot, *FString::Join(ErrorMessages, TEXT("\n")));
+	}
+
+	// Shallower files first, as deeper ones override them
+	Algo::SortBy(AttributesFiles, [](const FString& InPath)
+		{
+			int32 Depth = 0;
+			for (const TCHAR Char : InPath)
+			{
+				Depth += Char == TEXT('/') ? 1 : 0;
+			}
+			return Depth;
+		});
+
+	// The root file is always watched, even if it doesn't exist yet
+	const FString RootFile = Attributes->RepositoryRoot + AttributesFileName;
+	if (!AttributesFiles.Contains(RootFile))
+	{
+		AttributesFiles.Insert(RootFile, 0);
+	}
+	// and the repository's own attributes override everything
+	AttributesFiles.Add(Attributes->RepositoryRoot / TEXT(".git/info/attributes"));
+
+	TMap<FString, bool> Macros;
+	for (const FString& File : AttributesFiles)
+	{
+		Attributes->SourceFiles.Emplace(File, FileManager.GetTimeStamp(*File));
+
+		FString Content;
+		if (!FFileHelper::LoadFileToString(Content, *File))
+		{
+			continue;
+		}
+
+		const bool bInfo = !File.EndsWith(AttributesFileName);
+		FString Scope = bInfo ? FString() : FPaths::GetPath(File) + TEXT("/");
+		Scope.RightChopInline(FMath::Min(Attributes->RepositoryRoot.Len(), Scope.Len()));
+		Attributes->ParseFile(Content, Scope, Scope.IsEmpty(), Macros);
+	}
+
+	Algo::SortBy(Attributes->GlobRules, [&Attributes](const int32 InRule) { return -Attributes->Rules[InRule].Priority; });
+
+	UE_LOG(LogSourceControl, Log, TEXT("Loaded %d lockable patterns from %d attributes files"), Attributes->Rules.Num(), AttributesFiles.Num());
+
+	return Attributes;
+}
+
+void FFriendshipperGitAttributes::ParseFile(const FString& InContent, const FString& InScope, const bool bInAllowMacros, TMap<FString, bool>& InOutMacros)
+{
+	TArray<FString> Lines;
+	InContent.ParseIntoArrayLines(Lines);
+
+	for (FString& Line : Lines)
+	{
+		Line.TrimStartAndEndInline();
+		if (Line.IsEmpty() || Line.StartsWith(TEXT("#")))
+		{
+			continue;
+		}
+
+		FString Pattern;
+		TArray<FString> Tokens;
+		if (!SplitLine(Line, Pattern, Tokens))
+		{
+			continue;
+		}
+
+		// Later attributes on a line override earlier ones, and macros expand in place
+		TOptional<bool> Lockable;
+		for (const FString& Token : Tokens)
+		{
+			if (Token.StartsWith(TEXT("-")) || Token.StartsWith(TEXT("!")))
+			{
+				if (Token.RightChop(1) == LockableAttribute)
+				{
+					Lockable = false;
+				}
+				continue;
+			}
+
+			FString Name = Token;
+			FString Value;
+			Token.Split(TEXT("="), &Name, &Value);
+			if (Name == LockableAttribute)
+			{
+				Lockable = Value.IsEmpty() || Value == TEXT("true");
+			}
+			else if (const bool* Macro = Value.IsEmpty() ? InOutMacros.Find(Name) : nullptr)
+			{
+				Lockable = *Macro;
+			}
+		}
+
+		if (Pattern.StartsWith(TEXT("[attr]")))
+		{
+			if (bInAllowMacros && Lockable.IsSet())
+			{
+				InOutMacros.Add(Pattern.RightChop(6), Lockable.GetValue());
+			}
+			continue;
+		}
+
+		// Negative patterns are forbidden, and patterns matching directories don't apply to the files inside
+		if (!Lockable.IsSet() || Pattern.StartsWith(TEXT("!")) || Pattern.EndsWith(TEXT("/")))
+		{
+			continue;
+		}
+
+		AddRule(InScope, MoveTemp(Pattern), Lockable.GetValue());
+	}
+}
+
+void FFriendshipperGitAttributes::AddRule(const FString& InScope, FString InPattern, const bool bInLockable)
+{
+	const bool bAnchored = InPattern.Contains(TEXT("/"));
+	InPattern.RemoveFromStart(TEXT("/"));
+
+	const int32 RuleIndex = Rules.Num();
+	FRule& Rule = Rules.AddDefaulted_GetRef();
+	Rule.Scope = InScope;
+	Rule.Priority = RuleIndex;
+	Rule.bLockable = bInLockable;
+
+	const bool bWildcards = HasWildcards(InPattern);
+	if (!bAnchored)
+	{
+		bNameOnly &= InScope.IsEmpty();
+
+		const FStringView Extension = FStringView(InPattern).RightChop(1);
+		if (!bWildcards)
+		{
+			Rule.Kind = ERuleKind::Name;
+			Rule.Pattern = MoveTemp(InPattern);
+			NameRules.FindOrAdd(HashKey(Rule.Pattern)).Add(RuleIndex);
+		}
+		else if (InPattern.StartsWith(TEXT("*")) && Extension.StartsWith(TEXT('.')) && !HasWildcards(Extension))
+		{
+			Rule.Kind = ERuleKind::Extension;
+			Rule.Pattern = FString(Extension);
+			ExtensionRules.FindOrAdd(HashKey(Rule.Pattern)).Add(RuleIndex);
+		}
+		else
+		{
+			Rule.Kind = ERuleKind::Glob;
+			Rule.bMatchName = true;
+			Rule.Pattern = MoveTemp(InPattern);
+			GlobRules.Add(RuleIndex);
+		}
+	}
+	else
+	{
+		bNameOnly = false;
+
+		if (!bWildcards)
+		{
+			Rule.Kind = ERuleKind::Path;
+			Rule.Pattern = InScope + InPattern;
+			PathRules.FindOrAdd(HashKey(Rule.Pattern)).Add(RuleIndex);
+		}
+		else
+		{
+			Rule.Kind = ERuleKind::Glob;
+			Rule.Pattern = MoveTemp(InPattern);
+			GlobRules.Add(RuleIndex);
+		}
+	}
+}
+
+void FFriendshipperGitAttributes::MatchLiteral(const TMap<uint32, TArray<int32>>& InRules, const FStringView InKey, const FStringView InRelativePath, int32& InOutPriority, bool& bOutLockable) const
+{
+	const TArray<int32>* Candidates = InRules.Find(HashKey(InKey));
+	if (!Candidates)
+	{
+		return;
+	}
+
+	for (const int32 RuleIndex : *Candidates)
+	{
+		const FRule& Rule = Rules[RuleIndex];
+		if (Rule.Priority > InOutPriority && InRelativePath.StartsWith(Rule.Scope, ESearchCase::IgnoreCase) && InKey.Equals(Rule.Pattern, ESearchCase::IgnoreCase))
+		{
+			InOutPriority = Rule.Priority;
+			bOutLockable = Rule.bLockable;
+		}
+	}
+}
+
+bool FFriendshipperGitAttributes::IsLockableRelative(const FStringView InRelativePath) const
+{
+	const FStringView Name = FPathViews::GetCleanFilename(InRelativePath);
+
+	int32 Priority = INDEX_NONE;
+	bool bLockable = false;
+
+	if (ExtensionRules.Num() > 0)
+	{
+		for (int32 Index = 0; Index < Name.Len(); ++Index)
+		{
+			if (Name[Index] == TEXT('.'))
+			{
+				MatchLiteral(ExtensionRules, Name.RightChop(Index), InRelativePath, Priority, bLockable);
+			}
+		}
+	}
+	if (NameRules.Num() > 0)
+	{
+		MatchLiteral(NameRules, Name, InRelativePath, Priority, bLockable);
+	}
+	if (PathRules.Num() > 0)
+	{
+		MatchLiteral(PathRules, InRelativePath, InRelativePath, Priority, bLockable);
+	}
+
+	for (const int32 RuleIndex : GlobRules)
+	{
+		const FRule& Rule = Rules[RuleIndex];
+		if (Rule.Priority <= Priority)
+		{
+			break;
+		}
+		if (InRelativePath.StartsWith(Rule.Scope, ESearchCase::IgnoreCase) && WildMatch(Rule.Pattern, Rule.bMatchName ? Name : InRelativePath.RightChop(Rule.Scope.Len())))
+		{
+			return Rule.bLockable;
+		}
+	}
+
+	return bLockable;
+}
+
+bool FFriendshipperGitAttributes::IsLockable(const FStringView InAbsolutePath) const
+{
+	if (Rules.IsEmpty())
+	{
+		return false;
+	}
+
+	if (!InAbsolutePath.StartsWith(RepositoryRoot, ESearchCase::IgnoreCase))
+	{
+		// Name only rules still apply to bare file names
+		return bNameOnly && IsLockableRelative(FPathViews::GetCleanFilename(InAbsolutePath));
+	}
+
+	return IsLockableRelative(InAbsolutePath.RightChop(RepositoryRoot.Len()));
+}
+
+bool FFriendshipperGitAttributes::IsLockable(const FFriendshipperPathId InPath, const FFriendshipperPathTable& InPathTable) const
+{
+	if (Rules.IsEmpty() || !InPath.IsValid())
+	{
+		return false;
+	}
+
+	if (bNameOnly)
+	{
+		return IsLockableRelative(InPathTable.GetName(InPath));
+	}
+
+	return IsLockable(FStringView(InPathTable.GetPath(InPath)));
+}
+
+bool FFriendshipperGitAttributes::IsUpToDate() const
+{
+	IFileManager& FileManager = IFileManager::Get();
+	for (const TPair<FString, FDateTime>& SourceFile : SourceFiles)
+	{
+		if (FileManager.GetTimeStamp(*SourceFile.Key) != SourceFile.Value)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool FFriendshipperGitAttributes::IsAttributesFile(const FStringView InPath)
+{
+	return FPathViews::GetCleanFilename(InPath).Equals(AttributesFileName, ESearchCase::IgnoreCase);
+}
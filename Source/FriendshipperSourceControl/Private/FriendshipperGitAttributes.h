@@ -0,0 +1,96 @@
+// Copyright The Believer Company. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FriendshipperPathTable.h"
+#include "Misc/DateTime.h"
+
+/**
+ * The `lockable` attribute of every path in a repository, compiled from its .gitattributes files.
+ *
+ * Follows gitattributes(5): patterns without a slash match file names at any depth below the attributes file, other
+ * patterns are anchored to its directory. Deeper attributes files override shallower ones, .git/info/attributes
+ * overrides them all, and later lines override earlier ones. Only patterns setting, unsetting or unspecifying
+ * `lockable` (directly or through an [attr] macro) are kept.
+ *
+ * Literal file names, extensions and paths are answered from hash maps, only patterns with other wildcards are
+ * matched one by one. Instances are immutable once loaded, so they can be shared between threads.
+ */
+class FFriendshipperGitAttributes
+{
+public:
+	/** Find the attributes files tracked by git in a repository and parse them. Missing files just mean nothing is lockable. */
+	static TSharedRef<const FFriendshipperGitAttributes, ESPMode::ThreadSafe> Load(const FString& InPathToGitBinary, const FString& InRepositoryRoot);
+
+	/** Is the lockable attribute set on a file, given its absolute path */
+	bool IsLockable(FStringView InAbsolutePath) const;
+
+	/** Is the lockable attribute set on an interned absolute path. Only rebuilds the path when a rule needs more than the file name. */
+	bool IsLockable(FFriendshipperPathId InPath, const FFriendshipperPathTable& InPathTable = FFriendshipperPathTable::Get()) const;
+
+	/** False if any of the attributes files read by Load was added, modified or removed since */
+	bool IsUpToDate() const;
+
+	/** Is this the path of an attributes file */
+	static bool IsAttributesFile(FStringView InPath);
+
+	/** Number of compiled rules */
+	int32 NumRules() const
+	{
+		return Rules.Num();
+	}
+
+private:
+	enum class ERuleKind : uint8
+	{
+		/** "*.ext", matched on the file name extension(s) */
+		Extension,
+		/** File name without wildcards */
+		Name,
+		/** Path relative to the attributes file, without wildcards */
+		Path,
+		/** Anything else, matched with WildMatch */
+		Glob,
+	};
+
+	struct FRule
+	{
+		/** Directory of the attributes file relative to the repository root, with a trailing slash ("" for the root) */
+		FString Scope;
+		/** Pattern, relative to Scope when anchored. For literal rules, the text looked up: extension, name or relative path. */
+		FString Pattern;
+		/** Rules with a higher priority override lower ones */
+		int32 Priority = 0;
+		ERuleKind Kind = ERuleKind::Glob;
+		/** Glob patterns without a slash match the file name only */
+		bool bMatchName = false;
+		bool bLockable = false;
+	};
+
+	/** Parse one attributes file, appending its rules. Macros can only be defined by root level files. */
+	void ParseFile(const FString& InContent, const FString& InScope, bool bInAllowMacros, TMap<FString, bool>& InOutMacros);
+	void AddRule(const FString& InScope, FString InPattern, bool bInLockable);
+
+	/** Apply the best literal rule stored under InKey, if its priority is above InOutPriority */
+	void MatchLiteral(const TMap<uint32, TArray<int32>>& InRules, FStringView InKey, FStringView InRelativePath, int32& InOutPriority, bool& bOutLockable) const;
+
+	bool IsLockableRelative(FStringView InRelativePath) const;
+
+	/** Repository root, with a trailing slash */
+	FString RepositoryRoot;
+
+	TArray<FRule> Rules;
+	/** Literal rules, by case insensitive hash of their extension, name or path */
+	TMap<uint32, TArray<int32>> ExtensionRules;
+	TMap<uint32, TArray<int32>> NameRules;
+	TMap<uint32, TArray<int32>> PathRules;
+	/** By decreasing priority */
+	TArray<int32> GlobRules;
+
+	/** All rules are root level file name rules, so a path's file name is enough to match it */
+	bool bNameOnly = true;
+
+	/** Attributes files read by Load, with their timestamps (MinValue for a missing file) */
+	TArray<TPair<FString, FDateTime>> SourceFiles;
+};
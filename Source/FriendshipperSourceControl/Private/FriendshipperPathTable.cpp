@@ -0,0 +1,294 @@
+// Copyright The Believer Company. All Rights Reserved.
+
+#include "FriendshipperPathTable.h"
+
+#include "Misc/Crc.h"
+#include "Misc/ScopeRWLock.h"
+
+namespace FriendshipperPathTableConstants
+{
+/** Names are stored in chunks of this many characters, longer names get a chunk of their own */
+const int32 NameChunkSize = 64 * 1024;
+
+const int32 MinNumBuckets = 1024;
+} // namespace FriendshipperPathTableConstants
+
+namespace
+{
+/** Call InFunc on each component of a path split on '/', stopping early if it returns false */
+template <typename FuncType>
+bool ForEachComponent(FStringView InPath, FuncType&& InFunc)
+{
+	int32 Start = 0;
+	for (int32 Index = 0; Index <= InPath.Len(); ++Index)
+	{
+		if (Index == InPath.Len() || InPath[Index] == TEXT('/'))
+		{
+			if (!InFunc(InPath.Mid(Start, Index - Start)))
+			{
+				return false;
+			}
+			Start = Index + 1;
+		}
+	}
+	return true;
+}
+} // namespace
+
+FFriendshipperPathTable::FFriendshipperPathTable()
+{
+	FNode& Root = Nodes.AddZeroed_GetRef();
+	Root.Name = TEXT("");
+	Buckets.Init(0, FriendshipperPathTableConstants::MinNumBuckets);
+}
+
+FFriendshipperPathTable::~FFriendshipperPathTable() = default;
+
+FFriendshipperPathTable& FFriendshipperPathTable::Get()
+{
+	static FFriendshipperPathTable Table;
+	return Table;
+}
+
+uint32 FFriendshipperPathTable::HashComponent(const uint32 InParent, const FStringView InName)
+{
+	return HashCombine(InParent, FCrc::Strihash_DEPRECATED(InName.Len(), InName.GetData()));
+}
+
+uint32 FFriendshipperPathTable::FindChildLocked(const uint32 InParent, const FStringView InName, const uint32 InHash) const
+{
+	for (uint32 NodeIndex = Buckets[InHash & (Buckets.Num() - 1)]; NodeIndex != 0; NodeIndex = Nodes[NodeIndex].NextInBucket)
+	{
+		const FNode& Node = Nodes[NodeIndex];
+		if (Node.Hash == InHash && Node.Parent == InParent && FStringView(Node.Name, Node.NameLen).Equals(InName, ESearchCase::IgnoreCase))
+		{
+			return NodeIndex;
+		}
+	}
+	return 0;
+}
+
+uint32 FFriendshipperPathTable::FindLocked(const FStringView InPath) const
+{
+	uint32 Current = 0;
+	const bool bFound = ForEachComponent(InPath, [this, &Current](const FStringView Component)
+		{
+			Current = FindChildLocked(Current, Component, HashComponent(Current, Component));
+			return Current != 0;
+		});
+	return bFound ? Current : 0;
+}
+
+const TCHAR* FFriendshipperPathTable::StoreNameLocked(const FStringView InName)
+{
+	if (InName.IsEmpty())
+	{
+		return TEXT("");
+	}
+
+	TCHAR* Name = nullptr;
+	if (InName.Len() > FriendshipperPathTableConstants::NameChunkSize / 4)
+	{
+		// Dedicated chunk, the current one keeps being filled
+		Name = NameChunks.Add_GetRef(MakeUnique<TCHAR[]>(InName.Len())).Get();
+		NameBytes += InName.Len() * sizeof(TCHAR);
+	}
+	else
+	{
+		if (!NameChunk || NameChunkUsed + InName.Len() > FriendshipperPathTableConstants::NameChunkSize)
+		{
+			NameChunk = NameChunks.Add_GetRef(MakeUnique<TCHAR[]>(FriendshipperPathTableConstants::NameChunkSize)).Get();
+			NameChunkUsed = 0;
+			NameBytes += FriendshipperPathTableConstants::NameChunkSize * sizeof(TCHAR);
+		}
+		Name = NameChunk + NameChunkUsed;
+		NameChunkUsed += InName.Len();
+	}
+
+	FMemory::Memcpy(Name, InName.GetData(), InName.Len() * sizeof(TCHAR));
+	return Name;
+}
+
+void FFriendshipperPathTable::RehashLocked(const int32 InNumBuckets)
+{
+	Buckets.Init(0, InNumBuckets);
+	for (int32 NodeIndex = 1; NodeIndex < Nodes.Num(); ++NodeIndex)
+	{
+		FNode& Node = Nodes[NodeIndex];
+		uint32& Head = Buckets[Node.Hash & (InNumBuckets - 1)];
+		Node.NextInBucket = Head;
+		Head = NodeIndex;
+	}
+}
+
+uint32 FFriendshipperPathTable::AddChildLocked(const uint32 InParent, const FStringView InName, const uint32 InHash)
+{
+	const uint32 NodeIndex = Nodes.Num();
+
+	FNode& Node = Nodes.AddZeroed_GetRef();
+	Node.Name = StoreNameLocked(InName);
+	Node.NameLen = InName.Len();
+	Node.Parent = InParent;
+	Node.Hash = InHash;
+	Node.NextSibling = Nodes[InParent].FirstChild;
+	Nodes[InParent].FirstChild = NodeIndex;
+
+	if (Nodes.Num() > Buckets.Num())
+	{
+		RehashLocked(Buckets.Num() * 2);
+	}
+	else
+	{
+		uint32& Head = Buckets[InHash & (Buckets.Num() - 1)];
+		Node.NextInBucket = Head;
+		Head = NodeIndex;
+	}
+
+	return NodeIndex;
+}
+
+FStringView FFriendshipperPathTable::TrimTrailingSlashes(FStringView InPath)
+{
+	while (InPath.EndsWith(TEXT('/')))
+	{
+		InPath.LeftChopInline(1);
+	}
+	return InPath;
+}
+
+FFriendshipperPathId FFriendshipperPathTable::Intern(const FStringView InPath)
+{
+	if (InPath.IsEmpty())
+	{
+		return FFriendshipperPathId();
+	}
+
+	{
+		FReadScopeLock ReadLock(Lock);
+		if (const uint32 Found = FindLocked(InPath))
+		{
+			return FFriendshipperPathId{Found};
+		}
+	}
+
+	FWriteScopeLock WriteLock(Lock);
+	uint32 Current = 0;
+	ForEachComponent(InPath, [this, &Current](const FStringView Component)
+		{
+			const uint32 Hash = HashComponent(Current, Component);
+			const uint32 Child = FindChildLocked(Current, Component, Hash);
+			Current = Child ? Child : AddChildLocked(Current, Component, Hash);
+			return true;
+		});
+	return FFriendshipperPathId{Current};
+}
+
+FFriendshipperPathId FFriendshipperPathTable::InternChild(const FFriendshipperPathId InParent, const FStringView InName)
+{
+	const uint32 Hash = HashComponent(InParent.Index, InName);
+	{
+		FReadScopeLock ReadLock(Lock);
+		if (const uint32 Found = FindChildLocked(InParent.Index, InName, Hash))
+		{
+			return FFriendshipperPathId{Found};
+		}
+	}
+
+	FWriteScopeLock WriteLock(Lock);
+	const uint32 Child = FindChildLocked(InParent.Index, InName, Hash);
+	return FFriendshipperPathId{Child ? Child : AddChildLocked(InParent.Index, InName, Hash)};
+}
+
+FFriendshipperPathId FFriendshipperPathTable::Find(const FStringView InPath) const
+{
+	if (InPath.IsEmpty())
+	{
+		return FFriendshipperPathId();
+	}
+
+	FReadScopeLock ReadLock(Lock);
+	return FFriendshipperPathId{FindLocked(InPath)};
+}
+
+FString FFriendshipperPathTable::GetPath(const FFriendshipperPathId InId) const
+{
+	FString Path;
+	if (!InId.IsValid())
+	{
+		return Path;
+	}
+
+	FReadScopeLock ReadLock(Lock);
+
+	TArray<uint32, TInlineAllocator<32>> Components;
+	int32 Len = 0;
+	for (uint32 NodeIndex = InId.Index; NodeIndex != 0; NodeIndex = Nodes[NodeIndex].Parent)
+	{
+		Components.Add(NodeIndex);
+		Len += Nodes[NodeIndex].NameLen + 1;
+	}
+
+	Path.Reserve(Len);
+	for (int32 Index = Components.Num() - 1; Index >= 0; --Index)
+	{
+		const FNode& Node = Nodes[Components[Index]];
+		Path.AppendChars(Node.Name, Node.NameLen);
+		if (Index > 0)
+		{
+			Path.AppendChar(TEXT('/'));
+		}
+	}
+	return Path;
+}
+
+FStringView FFriendshipperPathTable::GetName(const FFriendshipperPathId InId) const
+{
+	FReadScopeLock ReadLock(Lock);
+	const FNode& Node = Nodes[InId.Index];
+	return FStringView(Node.Name, Node.NameLen);
+}
+
+FFriendshipperPathId FFriendshipperPathTable::GetParent(const FFriendshipperPathId InId) const
+{
+	FReadScopeLock ReadLock(Lock);
+	return FFriendshipperPathId{Nodes[InId.Index].Parent};
+}
+
+void FFriendshipperPathTable::GetFilesUnder(const FFriendshipperPathId InDirectory, TArray<FFriendshipperPathId>& OutFiles) const
+{
+	if (!InDirectory.IsValid())
+	{
+		return;
+	}
+
+	FReadScopeLock ReadLock(Lock);
+
+	TArray<uint32, TInlineAllocator<64>> Directories;
+	Directories.Add(InDirectory.Index);
+	while (Directories.Num() > 0)
+	{
+		for (uint32 Child = Nodes[Directories.Pop()].FirstChild; Child != 0; Child = Nodes[Child].NextSibling)
+		{
+			if (Nodes[Child].FirstChild != 0)
+			{
+				Directories.Add(Child);
+			}
+			else
+			{
+				OutFiles.Add(FFriendshipperPathId{Child});
+			}
+		}
+	}
+}
+
+int32 FFriendshipperPathTable::Num() const
+{
+	FReadScopeLock ReadLock(Lock);
+	return Nodes.Num() - 1;
+}
+
+SIZE_T FFriendshipperPathTable::GetAllocatedSize() const
+{
+	FReadScopeLock ReadLock(Lock);
+	return Nodes.GetAllocatedSize() + Buckets.GetAllocatedSize() + NameChunks.GetAllocatedSize() + NameBytes;
+}
@@ -0,0 +1,124 @@
+// Copyright The Believer Company. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/StringView.h"
+
+/** Stable handle to a path interned in FFriendshipperPathTable. Cheap to copy, hash and compare. */
+struct FFriendshipperPathId
+{
+	uint32 Index = 0;
+
+	bool IsValid() const
+	{
+		return Index != 0;
+	}
+
+	bool operator==(const FFriendshipperPathId& Other) const
+	{
+		return Index == Other.Index;
+	}
+
+	bool operator!=(const FFriendshipperPathId& Other) const
+	{
+		return Index != Other.Index;
+	}
+
+	friend uint32 GetTypeHash(const FFriendshipperPathId& Id)
+	{
+		return Id.Index;
+	}
+};
+
+/** Immutable set of interned paths, shared between threads without copying. Replaced as a whole rather than modified. */
+using FFriendshipperPathSetRef = TSharedRef<const TSet<FFriendshipperPathId>, ESPMode::ThreadSafe>;
+
+/**
+ * Interned file paths, stored as a parent-pointer table: every path component is stored once and points to its
+ * parent directory, so the thousands of files under the same directory share its prefix. Components are also linked
+ * to their children, so that the files under a directory can be listed.
+ *
+ * Paths are split on '/' and rebuilt exactly as they were first interned. Like FString keys in a TMap, matching is
+ * case insensitive. Ids are never released, so they stay valid for the lifetime of the table. All methods are thread safe.
+ */
+class FFriendshipperPathTable
+{
+public:
+	FFriendshipperPathTable();
+	~FFriendshipperPathTable();
+
+	/** Table shared by the whole plugin */
+	static FFriendshipperPathTable& Get();
+
+	/**
+	 * Strip the trailing slashes of a directory path before interning it. "Content/" would otherwise intern an empty
+	 * named component under Content, which the files under the directory are not parented to.
+	 */
+	static FStringView TrimTrailingSlashes(FStringView InPath);
+
+	/** Get the id of a path, adding it to the table if needed. Returns an invalid id for an empty path. */
+	FFriendshipperPathId Intern(FStringView InPath);
+
+	/** Get the id of a single component under a parent path (or at the top level for an invalid parent), adding it if needed */
+	FFriendshipperPathId InternChild(FFriendshipperPathId InParent, FStringView InName);
+
+	/** Get the id of an already interned path, or an invalid id if it isn't in the table */
+	FFriendshipperPathId Find(FStringView InPath) const;
+
+	/** Rebuild the full path of an id */
+	FString GetPath(FFriendshipperPathId InId) const;
+
+	/** Last component of a path, ie. the file name. The view stays valid for the lifetime of the table. */
+	FStringView GetName(FFriendshipperPathId InId) const;
+
+	/** Directory containing a path, invalid for top level components */
+	FFriendshipperPathId GetParent(FFriendshipperPathId InId) const;
+
+	/**
+	 * Append the paths interned under a directory that have nothing under them, ie. its files, walking only its
+	 * subtree. Appends nothing for a file, or for a directory nothing was interned under.
+	 */
+	void GetFilesUnder(FFriendshipperPathId InDirectory, TArray<FFriendshipperPathId>& OutFiles) const;
+
+	/** Number of path components in the table (files and directories) */
+	int32 Num() const;
+
+	/** Memory used by the table */
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	struct FNode
+	{
+		const TCHAR* Name;
+		uint32 NameLen;
+		uint32 Parent;
+		uint32 Hash;
+		uint32 NextInBucket;
+		/** Children of the node, linked through NextSibling */
+		uint32 FirstChild;
+		uint32 NextSibling;
+	};
+
+	static uint32 HashComponent(uint32 InParent, FStringView InName);
+
+	uint32 FindChildLocked(uint32 InParent, FStringView InName, uint32 InHash) const;
+	uint32 FindLocked(FStringView InPath) const;
+	uint32 AddChildLocked(uint32 InParent, FStringView InName, uint32 InHash);
+	const TCHAR* StoreNameLocked(FStringView InName);
+	void RehashLocked(int32 InNumBuckets);
+
+	mutable FRWLock Lock;
+
+	/** Node 0 is the root every top level component is parented to, it never is a valid id */
+	TArray<FNode> Nodes;
+
+	/** Heads of the hash chains of (parent, name) pairs, linked through FNode::NextInBucket */
+	TArray<uint32> Buckets;
+
+	/** Name storage. Chunks are never reallocated, so names can be referenced directly. */
+	TArray<TUniquePtr<TCHAR[]>> NameChunks;
+	TCHAR* NameChunk = nullptr;
+	int32 NameChunkUsed = 0;
+	SIZE_T NameBytes = 0;
+};
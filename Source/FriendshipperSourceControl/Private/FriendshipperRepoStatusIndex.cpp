@@ -0,0 +1,115 @@
+// Copyright The Believer Company. All Rights Reserved.
+
+#include "FriendshipperRepoStatusIndex.h"
+
+#include "FriendshipperClient.h"
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+
+namespace
+{
+/** Add the keys that are only in one of the maps, or mapped to different values */
+template <typename ValueType>
+void CollectChangedKeys(const TMap<FFriendshipperPathId, ValueType>& InA, const TMap<FFriendshipperPathId, ValueType>& InB, TSet<FFriendshipperPathId>& OutKeys)
+{
+	for (const TPair<FFriendshipperPathId, ValueType>& Pair : InA)
+	{
+		const ValueType* Other = InB.Find(Pair.Key);
+		if (!Other || !(*Other == Pair.Value))
+		{
+			OutKeys.Add(Pair.Key);
+		}
+	}
+	for (const TPair<FFriendshipperPathId, ValueType>& Pair : InB)
+	{
+		if (!InA.Contains(Pair.Key))
+		{
+			OutKeys.Add(Pair.Key);
+		}
+	}
+}
+} // namespace
+
+FFriendshipperRepoStatusIndex::FFriendshipperRepoStatusIndex(const FString& InRepositoryRoot, const FRepoStatus& InRepoStatus, FFriendshipperPathTable& InPathTable)
+	: PathTable(InPathTable)
+	, RemoteBranch(InRepoStatus.RemoteBranch)
+	, LastUpdated(InRepoStatus.LastUpdated)
+	, CommitHeadOrigin(InRepoStatus.CommitHeadOrigin)
+{
+	TreeStates.Reserve(InRepoStatus.UntrackedFiles.Num() + InRepoStatus.ModifiedFiles.Num());
+
+	// Modified files take precedence over untracked ones, so add them last
+	for (const FStatusFileState& StatusState : InRepoStatus.UntrackedFiles)
+	{
+		TreeStates.Add(PathTable.Intern(FPaths::ConvertRelativePathToFull(InRepositoryRoot, StatusState.Path)), ETreeState::Untracked);
+	}
+	for (const FStatusFileState& StatusState : InRepoStatus.ModifiedFiles)
+	{
+		TreeStates.Add(PathTable.Intern(FPaths::ConvertRelativePathToFull(InRepositoryRoot, StatusState.Path)), ETreeState::Working);
+	}
+
+	// Lock paths are relative to the project directory
+	const FString ProjectDir = IFileManager::Get().ConvertToAbsolutePathForExternalAppForRead(*FPaths::ProjectDir());
+
+	LockOwners.Reserve(InRepoStatus.LocksOurs.Num() + InRepoStatus.LocksTheirs.Num());
+	for (const FLfsLock& Lock : InRepoStatus.LocksOurs)
+	{
+		LockOwners.Add(PathTable.Intern(FPaths::ConvertRelativePathToFull(ProjectDir, Lock.Path)), Lock.Owner.Name);
+	}
+	for (const FLfsLock& Lock : InRepoStatus.LocksTheirs)
+	{
+		LockOwners.Add(PathTable.Intern(FPaths::ConvertRelativePathToFull(ProjectDir, Lock.Path)), Lock.Owner.Name);
+	}
+
+	ModifiedUpstream.Reserve(InRepoStatus.ModifiedUpstream.Num());
+	for (const FString& Modified : InRepoStatus.ModifiedUpstream)
+	{
+		ModifiedUpstream.Add(PathTable.Intern(FPaths::ConvertRelativePathToFull(InRepositoryRoot, Modified)));
+	}
+}
+
+ETreeState::Type FFriendshipperRepoStatusIndex::FindTreeState(const FFriendshipperPathId InPath) const
+{
+	const ETreeState::Type* TreeState = TreeStates.Find(InPath);
+	return TreeState ? *TreeState : ETreeState::Unset;
+}
+
+const FString* FFriendshipperRepoStatusIndex::FindLockOwner(const FFriendshipperPathId InPath) const
+{
+	return LockOwners.Find(InPath);
+}
+
+bool FFriendshipperRepoStatusIndex::IsModifiedUpstream(const FFriendshipperPathId InPath) const
+{
+	return ModifiedUpstream.Contains(InPath);
+}
+
+void FFriendshipperRepoStatusIndex::CollectChangedPaths(const FFriendshipperRepoStatusIndex& InOther, TSet<FFriendshipperPathId>& OutPaths) const
+{
+	check(&PathTable == &InOther.PathTable);
+	CollectChangedKeys(TreeStates, InOther.TreeStates, OutPaths);
+	CollectChangedKeys(LockOwners, InOther.LockOwners, OutPaths);
+
+	// The remote branch is part of the state of every file that isn't at head
+	if (RemoteBranch != InOther.RemoteBranch)
+	{
+		OutPaths.Append(ModifiedUpstream);
+		OutPaths.Append(InOther.ModifiedUpstream);
+		return;
+	}
+
+	for (const FFriendshipperPathId Path : ModifiedUpstream)
+	{
+		if (!InOther.ModifiedUpstream.Contains(Path))
+		{
+			OutPaths.Add(Path);
+		}
+	}
+	for (const FFriendshipperPathId Path : InOther.ModifiedUpstream)
+	{
+		if (!ModifiedUpstream.Contains(Path))
+		{
+			OutPaths.Add(Path);
+		}
+	}
+}
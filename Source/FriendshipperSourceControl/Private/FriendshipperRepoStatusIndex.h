@@ -0,0 +1,102 @@
+// Copyright The Believer Company. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FriendshipperPathTable.h"
+#include "FriendshipperSourceControlState.h"
+
+struct FRepoStatus;
+
+/**
+ * Lookup tables built once per FRepoStatus, so that classifying a file costs a few hash lookups instead of a scan
+ * over every status list. Status paths are relative to the repository root; they are stored here interned in the
+ * same normalized absolute form as the tracked file list, so lookups don't need to build any intermediate string.
+ * Paths are interned in the plugin's shared table unless another one is given, eg. to keep benchmarks isolated.
+ */
+class FFriendshipperRepoStatusIndex
+{
+public:
+	FFriendshipperRepoStatusIndex(const FString& InRepositoryRoot, const FRepoStatus& InRepoStatus, FFriendshipperPathTable& InPathTable = FFriendshipperPathTable::Get());
+
+	/** Table the paths of this index are interned in, and which the ids given to it must come from */
+	const FFriendshipperPathTable& GetPathTable() const
+	{
+		return PathTable;
+	}
+
+	/** Working tree state from the modified/untracked lists, or ETreeState::Unset if the file has no local changes */
+	ETreeState::Type FindTreeState(FFriendshipperPathId InPath) const;
+
+	/** Name of the user holding a lock on the file, or nullptr if it isn't locked */
+	const FString* FindLockOwner(FFriendshipperPathId InPath) const;
+
+	/** Is the file modified on the remote branch but not locally synced yet? */
+	bool IsModifiedUpstream(FFriendshipperPathId InPath) const;
+
+	/** Remote branch the upstream modifications are coming from */
+	const FString& GetRemoteBranch() const
+	{
+		return RemoteBranch;
+	}
+
+	/** When Friendshipper last refreshed the status, identifies the status this index was built from */
+	const FString& GetLastUpdated() const
+	{
+		return LastUpdated;
+	}
+
+	/** Head commit of the remote branch at that time */
+	const FString& GetCommitHeadOrigin() const
+	{
+		return CommitHeadOrigin;
+	}
+
+	/**
+	 * Collect every path whose entry differs between this status and another one, in any of the lists. These are the
+	 * only files whose state can differ when computed from one status or the other.
+	 */
+	void CollectChangedPaths(const FFriendshipperRepoStatusIndex& InOther, TSet<FFriendshipperPathId>& OutPaths) const;
+
+	/** Number of entries across all lists, mostly useful for logging */
+	int32 Num() const
+	{
+		return TreeStates.Num() + LockOwners.Num() + ModifiedUpstream.Num();
+	}
+
+private:
+	FFriendshipperPathTable& PathTable;
+
+	/** ETreeState::Working for modified files, ETreeState::Untracked for untracked ones */
+	TMap<FFriendshipperPathId, ETreeState::Type> TreeStates;
+
+	/** Lock owner name of every locked file, ours and theirs */
+	TMap<FFriendshipperPathId, FString> LockOwners;
+
+	/** Files that are not at the head of the remote branch */
+	TSet<FFriendshipperPathId> ModifiedUpstream;
+
+	FString RemoteBranch;
+	FString LastUpdated;
+	FString CommitHeadOrigin;
+};
+
+/**
+ * States computed from a new status, ready to be applied to the provider's cache on the game thread.
+ * When BaseStatusIndex is set, States only holds the files that changed since that status was applied.
+ */
+struct FFriendshipperStatusUpdate
+{
+	/** Status the states were computed from */
+	TSharedPtr<const FFriendshipperRepoStatusIndex, ESPMode::ThreadSafe> StatusIndex;
+
+	/** Previously applied status the changes were computed against, or null if States covers every tracked file */
+	TSharedPtr<const FFriendshipperRepoStatusIndex, ESPMode::ThreadSafe> BaseStatusIndex;
+
+	/** Tracked files, lockable attributes and lock user the states were computed with */
+	TSharedPtr<const TSet<FFriendshipperPathId>, ESPMode::ThreadSafe> Paths;
+	TSharedPtr<const class FFriendshipperGitAttributes, ESPMode::ThreadSafe> Attributes;
+	FString LockUser;
+
+	TMap<FFriendshipperPathId, FFriendshipperState> States;
+};
@@ -0,0 +1,403 @@
+// Copyright The Believer Company. All Rights Reserved.
+
+#include "Async/Async.h"
+#include "FriendshipperClient.h"
+#include "FriendshipperPathTable.h"
+#include "FriendshipperRepoStatusIndex.h"
+#include "FriendshipperSourceControlModule.h"
+#include "FriendshipperSourceControlUtils.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "ISourceControlModule.h"
+#include "Misc/Paths.h"
+#include "Misc/QueuedThreadPool.h"
+
+/**
+ * Editor only benchmarks for the status pipeline, run from the editor console. They only use synthetic data under a
+ * directory that doesn't exist in the repository, or synthetic work items on private thread pools, so they never touch
+ * the real cache or command lanes.
+ */
+namespace FriendshipperSourceControlBenchmarks
+{
+static const TCHAR* BenchmarkDirectory = TEXT("Content/__FriendshipperBenchmark__");
+
+static FString MakeRelativePath(const int32 Index)
+{
+	return FString::Printf(TEXT("%s/Dir%03d/Asset%07d.uasset"), BenchmarkDirectory, Index % 997, Index);
+}
+
+/** Builds a status where a few percent of NumFiles are modified, untracked, locked or out of date */
+static void MakeSyntheticStatus(const FString& InRepositoryRoot, const int32 NumFiles, TSet<FString>& OutAbsolutePaths, FRepoStatus& OutStatus)
+{
+	const FString ProjectDir = IFileManager::Get().ConvertToAbsolutePathForExternalAppForRead(*FPaths::ProjectDir());
+	const FString ProjectRelativeRoot = InRepositoryRoot.StartsWith(ProjectDir) ? InRepositoryRoot.RightChop(ProjectDir.Len()) : FString();
+
+	OutStatus.RemoteBranch = TEXT("origin/benchmark");
+	OutAbsolutePaths.Reserve(NumFiles);
+	for (int32 Index = 0; Index < NumFiles; ++Index)
+	{
+		const FString RelativePath = MakeRelativePath(Index);
+		OutAbsolutePaths.Add(FPaths::ConvertRelativePathToFull(InRepositoryRoot, RelativePath));
+
+		if (Index % 20 == 0)
+		{
+			FStatusFileState& Modified = OutStatus.ModifiedFiles.AddDefaulted_GetRef();
+			Modified.Path = RelativePath;
+		}
+		else if (Index % 97 == 0)
+		{
+			FStatusFileState& Untracked = OutStatus.UntrackedFiles.AddDefaulted_GetRef();
+			Untracked.Path = RelativePath;
+		}
+
+		if (Index % 50 == 1)
+		{
+			FLfsLock& Lock = (Index % 100 == 1) ? OutStatus.LocksOurs.AddDefaulted_GetRef() : OutStatus.LocksTheirs.AddDefaulted_GetRef();
+			Lock.Path = ProjectRelativeRoot / RelativePath;
+			Lock.Owner.Name = (Index % 100 == 1) ? TEXT("benchmark-us") : TEXT("benchmark-them");
+		}
+
+		if (Index % 50 == 2)
+		{
+			OutStatus.ModifiedUpstream.Add(RelativePath);
+		}
+	}
+}
+
+/** Matching as it was done before the status was indexed, kept as a reference point for the scaling curve */
+static int32 LinearMatch(const TSet<FString>& InFiles, const FRepoStatus& InStatus)
+{
+	int32 NumFound = 0;
+	for (const FString& File : InFiles)
+	{
+		bool bFound = false;
+		for (const FStatusFileState& StatusState : InStatus.ModifiedFiles)
+		{
+			if (File.EndsWith(StatusState.Path))
+			{
+				bFound = true;
+				break;
+			}
+		}
+		if (!bFound)
+		{
+			for (const FStatusFileState& StatusState : InStatus.UntrackedFiles)
+			{
+				if (File.EndsWith(StatusState.Path))
+				{
+					bFound = true;
+					break;
+				}
+			}
+		}
+		NumFound += bFound ? 1 : 0;
+	}
+	return NumFound;
+}
+
+static void RunStatusParseBenchmark(const TArray<FString>& Args)
+{
+	FFriendshipperSourceControlModule* GitSourceControl = FFriendshipperSourceControlModule::GetThreadSafe();
+	if (!GitSourceControl)
+	{
+		return;
+	}
+	const FString& RepositoryRoot = GitSourceControl->GetProvider().GetPathToRepositoryRoot();
+
+	TArray<int32> Sizes;
+	for (const FString& Arg : Args)
+	{
+		const int32 Size = FCString::Atoi(*Arg);
+		if (Size > 0)
+		{
+			Sizes.Add(Size);
+		}
+	}
+	if (Sizes.IsEmpty())
+	{
+		Sizes = {20000, 100000, 500000};
+	}
+
+	// The legacy scan is quadratic, past this many comparisons it would only freeze the editor
+	static constexpr int64 MaxLinearComparisons = 200 * 1000 * 1000;
+
+	// Compare single threaded and parallel state computation by flipping the cvar around each run
+	IConsoleVariable* ParallelCVar = IConsoleManager::Get().FindConsoleVariable(TEXT("Friendshipper.ParallelStateComputation"));
+	const bool bWasParallel = ParallelCVar ? ParallelCVar->GetBool() : true;
+
+	UE_LOG(LogSourceControl, Display, TEXT("Friendshipper status parse benchmark (root: %s)"), *RepositoryRoot);
+	UE_LOG(LogSourceControl, Display, TEXT("%10s %10s %12s %12s %12s %12s %12s"), TEXT("Files"), TEXT("Entries"), TEXT("Index ms"), TEXT("Serial ms"), TEXT("Parallel ms"), TEXT("us/file"), TEXT("Linear ms"));
+	for (const int32 NumFiles : Sizes)
+	{
+		TSet<FString> AbsolutePaths;
+		FRepoStatus Status;
+		MakeSyntheticStatus(RepositoryRoot, NumFiles, AbsolutePaths, Status);
+
+		// Private table, so that the synthetic paths don't stay interned in the editor's table for its lifetime
+		FFriendshipperPathTable PathTable;
+		TSet<FFriendshipperPathId> PathIds;
+		PathIds.Reserve(AbsolutePaths.Num());
+		for (const FString& Path : AbsolutePaths)
+		{
+			PathIds.Add(PathTable.Intern(Path));
+		}
+
+		const double IndexStart = FPlatformTime::Seconds();
+		const FFriendshipperRepoStatusIndex StatusIndex(RepositoryRoot, Status, PathTable);
+		const double IndexSeconds = FPlatformTime::Seconds() - IndexStart;
+
+		double StatesSeconds[2] = {0.0, 0.0};
+		int32 NumStates = 0;
+		for (int32 Run = 0; Run < 2; ++Run)
+		{
+			if (ParallelCVar)
+			{
+				ParallelCVar->Set(Run == 1, ECVF_SetByConsole);
+			}
+			const double StatesStart = FPlatformTime::Seconds();
+			const TMap<FFriendshipperPathId, FFriendshipperState> States = FriendshipperSourceControlUtils::FriendshipperStatesFromStatusIndex(PathIds, &PathIds, StatusIndex);
+			StatesSeconds[Run] = FPlatformTime::Seconds() - StatesStart;
+			NumStates = States.Num();
+		}
+
+		FString LinearResult = TEXT("skipped");
+		const int64 NumComparisons = int64(NumFiles) * (Status.ModifiedFiles.Num() + Status.UntrackedFiles.Num());
+		if (NumComparisons <= MaxLinearComparisons)
+		{
+			const double LinearStart = FPlatformTime::Seconds();
+			LinearMatch(AbsolutePaths, Status);
+			LinearResult = FString::Printf(TEXT("%.2f"), (FPlatformTime::Seconds() - LinearStart) * 1000.0);
+		}
+
+		UE_LOG(LogSourceControl, Display, TEXT("%10d %10d %12.2f %12.2f %12.2f %12.3f %12s"), NumStates, StatusIndex.Num(), IndexSeconds * 1000.0, StatesSeconds[0] * 1000.0,
+			   StatesSeconds[1] * 1000.0, (IndexSeconds + StatesSeconds[1]) * 1000000.0 / FMath::Max(NumFiles, 1), *LinearResult);
+	}
+
+	if (ParallelCVar)
+	{
+		ParallelCVar->Set(bWasParallel, ECVF_SetByConsole);
+	}
+}
+
+static void RunPathTableBenchmark(const TArray<FString>& Args)
+{
+	FFriendshipperSourceControlModule* GitSourceControl = FFriendshipperSourceControlModule::GetThreadSafe();
+	if (!GitSourceControl)
+	{
+		return;
+	}
+	const FString& RepositoryRoot = GitSourceControl->GetProvider().GetPathToRepositoryRoot();
+	const int32 NumFiles = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 100000;
+
+	TArray<FString> Paths;
+	Paths.Reserve(NumFiles);
+	for (int32 Index = 0; Index < NumFiles; ++Index)
+	{
+		Paths.Add(FPaths::ConvertRelativePathToFull(RepositoryRoot, MakeRelativePath(Index)));
+	}
+
+	// Baseline: what file-keyed containers used to hold
+	TSet<FString> StringSet;
+	SIZE_T StringBytes = 0;
+	for (const FString& Path : Paths)
+	{
+		StringSet.Add(Path);
+		StringBytes += Path.GetAllocatedSize();
+	}
+	StringBytes += StringSet.GetAllocatedSize();
+
+	// Private table, so that the numbers don't include the paths already interned by the editor
+	FFriendshipperPathTable PathTable;
+	TSet<FFriendshipperPathId> IdSet;
+	const double InternStart = FPlatformTime::Seconds();
+	for (const FString& Path : Paths)
+	{
+		IdSet.Add(PathTable.Intern(Path));
+	}
+	const double InternSeconds = FPlatformTime::Seconds() - InternStart;
+	const SIZE_T TableBytes = PathTable.GetAllocatedSize();
+	const SIZE_T IdSetBytes = IdSet.GetAllocatedSize();
+
+	int32 NumFound = 0;
+	const double StringLookupStart = FPlatformTime::Seconds();
+	for (const FString& Path : Paths)
+	{
+		NumFound += StringSet.Contains(Path) ? 1 : 0;
+	}
+	const double StringLookupSeconds = FPlatformTime::Seconds() - StringLookupStart;
+
+	const double FindStart = FPlatformTime::Seconds();
+	TArray<FFriendshipperPathId> Ids;
+	Ids.Reserve(NumFiles);
+	for (const FString& Path : Paths)
+	{
+		Ids.Add(PathTable.Find(Path));
+	}
+	const double FindSeconds = FPlatformTime::Seconds() - FindStart;
+
+	const double IdLookupStart = FPlatformTime::Seconds();
+	for (const FFriendshipperPathId Id : Ids)
+	{
+		NumFound += IdSet.Contains(Id) ? 1 : 0;
+	}
+	const double IdLookupSeconds = FPlatformTime::Seconds() - IdLookupStart;
+
+	const double GetPathStart = FPlatformTime::Seconds();
+	SIZE_T RebuiltLen = 0;
+	for (const FFriendshipperPathId Id : Ids)
+	{
+		RebuiltLen += PathTable.GetPath(Id).Len();
+	}
+	const double GetPathSeconds = FPlatformTime::Seconds() - GetPathStart;
+
+	UE_LOG(LogSourceControl, Display, TEXT("Friendshipper path table benchmark: %d files, %d path components (%d found, %llu chars rebuilt)"), NumFiles, PathTable.Num(), NumFound, (uint64)RebuiltLen);
+	UE_LOG(LogSourceControl, Display, TEXT("  Memory  TSet<FString>: %.2f MB, path table: %.2f MB + TSet<Id>: %.2f MB"), StringBytes / (1024.0 * 1024.0), TableBytes / (1024.0 * 1024.0), IdSetBytes / (1024.0 * 1024.0));
+	UE_LOG(LogSourceControl, Display, TEXT("  Intern %.2f ms, path to id %.2f ms, id to path %.2f ms"), InternSeconds * 1000.0, FindSeconds * 1000.0, GetPathSeconds * 1000.0);
+	UE_LOG(LogSourceControl, Display, TEXT("  Lookup  TSet<FString>: %.2f ms, TSet<Id>: %.2f ms"), StringLookupSeconds * 1000.0, IdLookupSeconds * 1000.0);
+}
+
+/** Stands in for a command: blocks a pool thread as long as a git or Friendshipper request would */
+class FSyntheticCommand : public IQueuedWork
+{
+public:
+	explicit FSyntheticCommand(const double InSeconds)
+		: Seconds(InSeconds)
+		, IssueTime(FPlatformTime::Seconds())
+	{
+	}
+
+	virtual void DoThreadedWork() override
+	{
+		FPlatformProcess::Sleep(static_cast<float>(Seconds));
+		Complete();
+	}
+
+	virtual void Abandon() override
+	{
+		Complete();
+	}
+
+	bool IsComplete() const
+	{
+		return bComplete;
+	}
+
+	double GetLatency() const
+	{
+		return CompleteTime - IssueTime;
+	}
+
+private:
+	void Complete()
+	{
+		CompleteTime = FPlatformTime::Seconds();
+		bComplete = true;
+	}
+
+	const double Seconds;
+	const double IssueTime;
+	double CompleteTime = 0.0;
+	std::atomic<bool> bComplete{false};
+};
+
+/** Issue a burst of refresh sized work items, then a check out sized one, and return how long the latter took */
+static double MeasureInteractiveLatency(FQueuedThreadPool& InRefreshPool, FQueuedThreadPool& InInteractivePool, const int32 InNumRefreshes, const double InRefreshSeconds, const double InInteractiveSeconds)
+{
+	TArray<TUniquePtr<FSyntheticCommand>> Commands;
+	for (int32 Index = 0; Index < InNumRefreshes; ++Index)
+	{
+		InRefreshPool.AddQueuedWork(Commands.Add_GetRef(MakeUnique<FSyntheticCommand>(InRefreshSeconds)).Get());
+	}
+	FSyntheticCommand* Interactive = Commands.Add_GetRef(MakeUnique<FSyntheticCommand>(InInteractiveSeconds)).Get();
+	InInteractivePool.AddQueuedWork(Interactive);
+
+	// Everything must be done before the work items are freed
+	while (Commands.ContainsByPredicate([](const TUniquePtr<FSyntheticCommand>& Command) { return !Command->IsComplete(); }))
+	{
+		FPlatformProcess::Sleep(0.001f);
+	}
+	return Interactive->GetLatency();
+}
+
+/** Private pool with the same layout as one the plugin uses, so that the benchmark never queues work on the real ones */
+static TUniquePtr<FQueuedThreadPool> CreateBenchmarkPool(const int32 InNumThreads, const EThreadPriority InPriority, const TCHAR* InName)
+{
+	TUniquePtr<FQueuedThreadPool> Pool(FQueuedThreadPool::Allocate());
+	if (!Pool->Create(FMath::Max(InNumThreads, 1), 128 * 1024, InPriority, InName))
+	{
+		UE_LOG(LogSourceControl, Error, TEXT("Failed to create the %s benchmark thread pool"), InName);
+		Pool.Reset();
+	}
+	return Pool;
+}
+
+static std::atomic<bool> bCommandLatencyBenchmarkRunning{false};
+
+static void RunCommandLatencyBenchmark(const TArray<FString>& Args)
+{
+	FFriendshipperSourceControlModule* GitSourceControl = FFriendshipperSourceControlModule::GetThreadSafe();
+	if (!GitSourceControl || GBackgroundPriorityThreadPool == nullptr)
+	{
+		return;
+	}
+	FFriendshipperSourceControlProvider& Provider = GitSourceControl->GetProvider();
+	FQueuedThreadPool* InteractivePool = Provider.GetCommandThreadPool(EFriendshipperCommandLane::Interactive);
+	FQueuedThreadPool* BackgroundPool = Provider.GetCommandThreadPool(EFriendshipperCommandLane::Background);
+	if (!InteractivePool || !BackgroundPool)
+	{
+		return;
+	}
+	if (bCommandLatencyBenchmarkRunning.exchange(true))
+	{
+		UE_LOG(LogSourceControl, Warning, TEXT("Friendshipper command latency benchmark already running"));
+		return;
+	}
+
+	const int32 NumRefreshes = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 64;
+	const double RefreshSeconds = Args.Num() > 1 ? FMath::Max(FCString::Atod(*Args[1]), 0.0) / 1000.0 : 0.2;
+	const double CheckOutSeconds = 0.02;
+	const int32 NumSharedThreads = GBackgroundPriorityThreadPool->GetNumThreads();
+	const int32 NumInteractiveThreads = InteractivePool->GetNumThreads();
+	const int32 NumBackgroundThreads = BackgroundPool->GetNumThreads();
+
+	// The bursts take seconds: wait for them away from the game thread
+	UE_LOG(LogSourceControl, Display, TEXT("Friendshipper command latency benchmark started, results are logged when done"));
+	AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [NumRefreshes, RefreshSeconds, CheckOutSeconds, NumSharedThreads, NumInteractiveThreads, NumBackgroundThreads]()
+		{
+			// Before: everything shared the engine background pool. After: refreshes and check outs each have their lane.
+			const TUniquePtr<FQueuedThreadPool> SharedPool = CreateBenchmarkPool(NumSharedThreads, TPri_BelowNormal, TEXT("FriendshipperBenchmarkShared"));
+			const TUniquePtr<FQueuedThreadPool> LaneInteractivePool = CreateBenchmarkPool(NumInteractiveThreads, TPri_Normal, TEXT("FriendshipperBenchmarkInteractive"));
+			const TUniquePtr<FQueuedThreadPool> LaneBackgroundPool = CreateBenchmarkPool(NumBackgroundThreads, TPri_BelowNormal, TEXT("FriendshipperBenchmarkBackground"));
+			if (SharedPool && LaneInteractivePool && LaneBackgroundPool)
+			{
+				const double SharedLatency = MeasureInteractiveLatency(*SharedPool, *SharedPool, NumRefreshes, RefreshSeconds, CheckOutSeconds);
+				const double LanesLatency = MeasureInteractiveLatency(*LaneBackgroundPool, *LaneInteractivePool, NumRefreshes, RefreshSeconds, CheckOutSeconds);
+
+				UE_LOG(LogSourceControl, Display, TEXT("Friendshipper command latency benchmark: synthetic check out (%.0f ms) issued behind %d synthetic refreshes of %.0f ms"), CheckOutSeconds * 1000.0, NumRefreshes, RefreshSeconds * 1000.0);
+				UE_LOG(LogSourceControl, Display, TEXT("  Shared pool (%d threads, like the engine background pool): %.2f ms"), NumSharedThreads, SharedLatency * 1000.0);
+				UE_LOG(LogSourceControl, Display, TEXT("  Lane pools (%d interactive, %d background threads): %.2f ms"), NumInteractiveThreads, NumBackgroundThreads, LanesLatency * 1000.0);
+			}
+			bCommandLatencyBenchmarkRunning = false;
+		});
+}
+
+// Auto-registered console commands:
+// No re-register on hot reload, and unregistered only once on editor shutdown.
+static FAutoConsoleCommand g_pathTableBenchmarkCommand(TEXT("Friendshipper.Benchmark.PathTable"),
+	TEXT("Compare memory and lookup speed of interned paths against plain strings.\n")
+	TEXT("Optional argument: number of files, 100000 by default."),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&RunPathTableBenchmark));
+
+static FAutoConsoleCommand g_statusParseBenchmarkCommand(TEXT("Friendshipper.Benchmark.StatusParse"),
+	TEXT("Measure how computing file states from a Friendshipper status scales with the number of files.\n")
+	TEXT("Optional arguments: list of file counts to run, eg. 'Friendshipper.Benchmark.StatusParse 20000 100000 500000'."),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&RunStatusParseBenchmark));
+
+static FAutoConsoleCommand g_commandLatencyBenchmarkCommand(TEXT("Friendshipper.Benchmark.CommandLatency"),
+	TEXT("Synthetic comparison of thread pool layouts: measure how long a check out sized work item waits behind a burst of refresh sized ones, ")
+	TEXT("with a single shared pool and with one pool per command lane. Work items only sleep, and don't go through IssueCommand, the lane selection ")
+	TEXT("or the scheduler. They run on private pools sized like the engine background pool and the command lanes, results are logged when done.\n")
+	TEXT("Optional arguments: number of refresh work items (64 by default) and duration of each in ms (200 by default)."),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&RunCommandLatencyBenchmark));
+} // namespace FriendshipperSourceControlBenchmarks
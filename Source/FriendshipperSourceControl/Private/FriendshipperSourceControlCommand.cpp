@@ -5,16 +5,24 @@
 
 #include "FriendshipperSourceControlCommand.h"
 
+#include "HAL/Event.h"
 #include "Modules/ModuleManager.h"
 #include "FriendshipperSourceControlModule.h"
 #include "FriendshipperSourceControlUtils.h"
 
+/** Command whose worker is running on this thread, see IsCurrentCommandCanceled */
+static thread_local const FFriendshipperSourceControlCommand* GCurrentCommand = nullptr;
+
 FFriendshipperSourceControlCommand::FFriendshipperSourceControlCommand(const TSharedRef<class ISourceControlOperation, ESPMode::ThreadSafe>& InOperation, const TSharedRef<class IFriendshipperSourceControlWorker, ESPMode::ThreadSafe>& InWorker, const FSourceControlOperationComplete& InOperationCompleteDelegate)
 	: Operation(InOperation)
 	, Worker(InWorker)
 	, OperationCompleteDelegate(InOperationCompleteDelegate)
 	, bExecuteProcessed(0)
 	, bCancelled(0)
+	, bCancelledResultsReturned(false)
+	, CompletionQueue(nullptr)
+	, CompletionEvent(nullptr)
+	, bCompletionProcessed(false)
 	, bCommandSuccessful(false)
 	, bAutoDelete(true)
 	, Concurrency(EConcurrency::Synchronous)
@@ -27,6 +35,14 @@ FFriendshipperSourceControlCommand::FFriendshipperSourceControlCommand(const TSh
 	PathToGitRoot = Provider.GetPathToGitRoot();
 }
 
+FFriendshipperSourceControlCommand::~FFriendshipperSourceControlCommand()
+{
+	if (CompletionEvent)
+	{
+		FPlatformProcess::ReturnSynchEventToPool(CompletionEvent);
+	}
+}
+
 void FFriendshipperSourceControlCommand::UpdateRepositoryRootIfSubmodule(const TArray<FString>& AbsoluteFilePaths)
 {
 	PathToRepositoryRoot = FriendshipperSourceControlUtils::ChangeRepositoryRootIfSubmodule(AbsoluteFilePaths, PathToRepositoryRoot);
@@ -34,15 +50,22 @@ void FFriendshipperSourceControlCommand::UpdateRepositoryRootIfSubmodule(const T
 
 bool FFriendshipperSourceControlCommand::DoWork()
 {
-	bCommandSuccessful = Worker->Execute(*this);
+	{
+		TGuardValue<const FFriendshipperSourceControlCommand*> CurrentCommandGuard(GCurrentCommand, this);
+		bCommandSuccessful = Worker->Execute(*this);
+	}
+	// Once signalled, the command can be delivered and deleted at any time: don't touch it anymore
+	const bool bSuccessful = bCommandSuccessful;
 	FPlatformAtomics::InterlockedExchange(&bExecuteProcessed, 1);
+	SignalCompletion();
 
-	return bCommandSuccessful;
+	return bSuccessful;
 }
 
 void FFriendshipperSourceControlCommand::Abandon()
 {
 	FPlatformAtomics::InterlockedExchange(&bExecuteProcessed, 1);
+	SignalCompletion();
 }
 
 void FFriendshipperSourceControlCommand::DoThreadedWork()
@@ -51,6 +74,19 @@ void FFriendshipperSourceControlCommand::DoThreadedWork()
 	DoWork();
 }
 
+void FFriendshipperSourceControlCommand::SignalCompletion()
+{
+	// Wake up the waiting thread first: once queued, the command can be delivered and deleted at any time
+	if (CompletionEvent)
+	{
+		CompletionEvent->Trigger();
+	}
+	if (CompletionQueue)
+	{
+		CompletionQueue->Enqueue(this);
+	}
+}
+
 void FFriendshipperSourceControlCommand::Cancel()
 {
 	FPlatformAtomics::InterlockedExchange(&bCancelled, 1);
@@ -61,6 +97,11 @@ bool FFriendshipperSourceControlCommand::IsCanceled() const
 	return bCancelled != 0;
 }
 
+bool FFriendshipperSourceControlCommand::IsCurrentCommandCanceled()
+{
+	return GCurrentCommand != nullptr && GCurrentCommand->IsCanceled();
+}
+
 ECommandResult::Type FFriendshipperSourceControlCommand::ReturnResults()
 {
 	// Save any messages that have accumulated
@@ -5,6 +5,7 @@
 
 #pragma once
 
+#include "Containers/Queue.h"
 #include "ISourceControlProvider.h"
 #include "Misc/IQueuedWork.h"
 
@@ -35,6 +36,8 @@ public:
 
 	FFriendshipperSourceControlCommand(const TSharedRef<class ISourceControlOperation, ESPMode::ThreadSafe>& InOperation, const TSharedRef<class IFriendshipperSourceControlWorker, ESPMode::ThreadSafe>& InWorker, const FSourceControlOperationComplete& InOperationCompleteDelegate = FSourceControlOperationComplete());
 
+	virtual ~FFriendshipperSourceControlCommand() override;
+
 	/**
 	 *  Modify the repo root if all selected files are in a plugin subfolder, and the plugin subfolder is a git repo
 	 *  This supports the case where each plugin is a sub module
@@ -61,12 +64,21 @@ public:
 	 */
 	virtual void DoThreadedWork() override;
 
+	/** Notify the game thread that this command was processed by its worker thread */
+	void SignalCompletion();
+
 	/** Attempt to cancel the operation */
 	void Cancel();
 
 	/** Is the operation canceled? */
 	bool IsCanceled() const;
 
+	/**
+	 * Is the command running on the calling thread canceled? Lets the git and Friendshipper helpers a worker calls stop
+	 * their process or request without the command being passed down to them. False outside of a command.
+	 */
+	static bool IsCurrentCommandCanceled();
+
 	/** Save any results and call any registered callbacks. */
 	ECommandResult::Type ReturnResults();
 
@@ -95,6 +107,18 @@ public:
 	/**If true, this command has been cancelled*/
 	volatile int32 bCancelled;
 
+	/** If true, the results of this cancelled command were returned, they are not returned again when it completes */
+	bool bCancelledResultsReturned;
+
+	/** Queue this command pushes itself into once processed by a worker thread, set when it is issued asynchronously */
+	TQueue<FFriendshipperSourceControlCommand*, EQueueMode::Mpsc>* CompletionQueue;
+
+	/** Triggered once processed by a worker thread, for synchronous commands to wait on. Owned by the command. */
+	FEvent* CompletionEvent;
+
+	/** If true, the results of this command were delivered on the game thread */
+	bool bCompletionProcessed;
+
 	/**If true, the revision control command succeeded*/
 	bool bCommandSuccessful;
 
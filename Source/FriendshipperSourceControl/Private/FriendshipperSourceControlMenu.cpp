@@ -218,16 +218,25 @@ void FFriendshipperSourceControlMenu::RevertAllCallback(const FSourceControlOper
 		return;
 	}
 
-	// Get a list of all the checked out packages
+	FFriendshipperSourceControlModule& GitSourceControl = FFriendshipperSourceControlModule::Get();
+	FFriendshipperSourceControlProvider& Provider = GitSourceControl.GetProvider();
+
+	// Get a list of all the submittable packages, like FEditorFileUtils::FindAllSubmittablePackageFiles but only
+	// going through the indexed states: files with something to revert always have pending work
 	TArray<FString> PackageNames;
 	TArray<UPackage*> LoadedPackages;
-	TMap<FString, FSourceControlStatePtr> PackageStates;
-	FEditorFileUtils::FindAllSubmittablePackageFiles(PackageStates, true);
+	const TArray<FSourceControlStateRef> SubmittableStates = Provider.GetPendingStateByPredicate([](const FSourceControlStateRef& State)
+		{
+			return State->IsCurrent() && (State->CanCheckIn() || (!State->IsSourceControlled() && !State->IsIgnored()));
+		});
 
-	for (TMap<FString, FSourceControlStatePtr>::TConstIterator PackageIter(PackageStates); PackageIter; ++PackageIter)
+	for (const FSourceControlStateRef& State : SubmittableStates)
 	{
-		const FString PackageName = *PackageIter.Key();
-		const FSourceControlStatePtr CurPackageSCCState = PackageIter.Value();
+		FString PackageName;
+		if (!FPackageName::IsPackageFilename(State->GetFilename()) || !FPackageName::TryConvertFilenameToLongPackageName(State->GetFilename(), PackageName))
+		{
+			continue;
+		}
 
 		UPackage* Package = FindPackage(nullptr, *PackageName);
 		if (Package != nullptr)
@@ -245,17 +254,12 @@ void FFriendshipperSourceControlMenu::RevertAllCallback(const FSourceControlOper
 		PackageNames.Add(PackageName);
 	}
 
-	FFriendshipperSourceControlModule& GitSourceControl = FFriendshipperSourceControlModule::Get();
-	FFriendshipperSourceControlProvider& Provider = GitSourceControl.GetProvider();
-	TArray<FString> SCCFiles = Provider.GetFilesInCache();
-	for (const FString& Filename : SCCFiles)
+	// Deleted files always have pending work, so this only goes through the indexed states
+	const TArray<FSourceControlStateRef> DeletedStates = Provider.GetPendingStateByPredicate([](const FSourceControlStateRef& State) { return State->IsDeleted(); });
+	for (const FSourceControlStateRef& State : DeletedStates)
 	{
-		TSharedRef<FFriendshipperSourceControlState, ESPMode::ThreadSafe> State = Provider.GetStateInternal(Filename);
-		if (State->IsDeleted())
-		{
-			FString PackageName = FPackageName::FilenameToLongPackageName(Filename);
-			PackageNames.Emplace(MoveTemp(PackageName));
-		}
+		FString PackageName = FPackageName::FilenameToLongPackageName(State->GetFilename());
+		PackageNames.Emplace(MoveTemp(PackageName));
 	}
 
 	RemoveInProgressNotification();
@@ -24,18 +24,25 @@
 #include <thread>
 
 #include "FriendshipperClient.h"
+#include "FriendshipperRepoStatusIndex.h"
+#include "HAL/IConsoleManager.h"
 #include "UObject/PackageTrailer.h"
 
 #define LOCTEXT_NAMESPACE "GitSourceControl"
 
-static bool LockFiles(const FString& PathToGitRoot, const TArray<FString>& Files, TMap<const FString, FFriendshipperState>& States, TArray<FString>* ErrorMessages)
+static TAutoConsoleVariable<bool> CVarSkipLockRequestForLockedFiles(
+	TEXT("Friendshipper.SkipLockRequestForLockedFiles"),
+	false,
+	TEXT("Fail the checkout of files the last status shows locked by someone else right away, without asking Friendshipper for their lock."));
+
+static bool LockFiles(const FString& PathToGitRoot, const TArray<FString>& Files, TMap<FFriendshipperPathId, FFriendshipperState>& States, TArray<FString>* ErrorMessages)
 {
 	if (Files.IsEmpty())
 	{
 		return true;
 	}
 
-	TArray<FString> LockableFiles = Files.FilterByPredicate(FriendshipperSourceControlUtils::IsFileLFSLockable);
+	TArray<FString> LockableFiles = Files.FilterByPredicate([](const FString& File) { return FriendshipperSourceControlUtils::IsFileLFSLockable(File); });
 	if (LockableFiles.IsEmpty())
 	{
 		return true;
@@ -73,10 +80,10 @@ static bool LockFiles(const FString& PathToGitRoot, const TArray<FString>& Files
 	if (bSuccess)
 	{
 		FriendshipperSourceControlUtils::CollectNewStates(SucceededFiles, States, EFileState::Unset, ETreeState::Unset, ELockState::Locked);
-		const FString& LockUser = FFriendshipperSourceControlModule::Get().GetProvider().GetLockUser();
+		const uint16 LockUserIndex = FFriendshipperNameTable::LockUsers().Intern(FFriendshipperSourceControlModule::Get().GetProvider().GetLockUser());
 		for (auto&& State : States)
 		{
-			State.Value.LockUser = LockUser;
+			State.Value.LockUserIndex = LockUserIndex;
 		}
 	}
 
@@ -140,11 +147,73 @@ FName FFriendshipperCheckOutWorker::GetName() const
 	return "CheckOut";
 }
 
+/**
+ * Tell from the last applied status which files can't be checked out or shouldn't be, before waiting on the lock
+ * request: files locked by someone else, and files modified upstream whose local content is stale. Returns false if
+ * some files locked by someone else were left out of OutFilesToLock, see Friendshipper.SkipLockRequestForLockedFiles,
+ * in which case they are reported in OutConflicts.
+ */
+static bool PredictCheckOut(const TArray<FString>& InFiles, TArray<FString>& OutFilesToLock, TArray<FString>& OutConflicts, FGitSourceControlResultInfo& OutResultInfo)
+{
+	FFriendshipperSourceControlProvider& Provider = FFriendshipperSourceControlModule::Get().GetProvider();
+	const TSharedPtr<const FFriendshipperRepoStatusIndex, ESPMode::ThreadSafe> StatusIndex = Provider.GetAppliedStatusIndex();
+	if (!StatusIndex.IsValid())
+	{
+		OutFilesToLock = InFiles;
+		return true;
+	}
+
+	const FFriendshipperPathTable& PathTable = FFriendshipperPathTable::Get();
+	const bool bSkipLockedFiles = CVarSkipLockRequestForLockedFiles.GetValueOnAnyThread();
+	bool bAllLockable = true;
+	for (const FString& File : InFiles)
+	{
+		const FFriendshipperPathId Path = PathTable.Find(File);
+		bool bSkipped = false;
+		if (Path.IsValid())
+		{
+			const FString* LockOwner = StatusIndex->FindLockOwner(Path);
+			if (LockOwner && *LockOwner != Provider.GetLockUser())
+			{
+				const FText Message = FText::Format(LOCTEXT("CheckOut_LockedOther", "{0} is locked by {1}"), FText::FromString(FPaths::GetCleanFilename(File)), FText::FromString(*LockOwner));
+				if (bSkipLockedFiles)
+				{
+					UE_LOG(LogSourceControl, Warning, TEXT("%s, not requesting its lock"), *Message.ToString());
+					OutResultInfo.ErrorMessages.Add(Message.ToString());
+					OutConflicts.Add(File);
+					bAllLockable = false;
+					bSkipped = true;
+				}
+				else
+				{
+					UE_LOG(LogSourceControl, Warning, TEXT("%s, its checkout will likely be rejected"), *Message.ToString());
+					OutResultInfo.InfoMessages.Add(Message.ToString());
+				}
+			}
+
+			if (StatusIndex->IsModifiedUpstream(Path))
+			{
+				const FText Message = FText::Format(LOCTEXT("CheckOut_ModifiedUpstream", "{0} is modified on {1}, sync before editing it to avoid conflicts"), FText::FromString(FPaths::GetCleanFilename(File)), FText::FromString(StatusIndex->GetRemoteBranch()));
+				UE_LOG(LogSourceControl, Warning, TEXT("%s"), *Message.ToString());
+				OutResultInfo.InfoMessages.Add(Message.ToString());
+			}
+		}
+		if (!bSkipped)
+		{
+			OutFilesToLock.Add(File);
+		}
+	}
+	return bAllLockable;
+}
+
 bool FFriendshipperCheckOutWorker::Execute(FFriendshipperSourceControlCommand& InCommand)
 {
 	check(InCommand.Operation->GetName() == GetName());
 
-	return LockFiles(InCommand.PathToGitRoot, InCommand.Files, States, &InCommand.ResultInfo.ErrorMessages);
+	TArray<FString> FilesToLock;
+	const bool bAllLockable = PredictCheckOut(InCommand.Files, FilesToLock, InCommand.Conflicts, InCommand.ResultInfo);
+
+	return LockFiles(InCommand.PathToGitRoot, FilesToLock, States, &InCommand.ResultInfo.ErrorMessages) && bAllLockable;
 }
 
 bool FFriendshipperCheckOutWorker::UpdateStates() const
@@ -192,24 +261,23 @@ bool FFriendshipperCheckInWorker::Execute(FFriendshipperSourceControlCommand& In
 	}
 
 	// Remove any deleted files from status cache
-	TArray<TSharedRef<ISourceControlState, ESPMode::ThreadSafe>> LocalStates;
-	Provider.GetState(InCommand.Files, LocalStates, EStateCacheUsage::Use);
-	for (const auto& State : LocalStates)
+	for (const FString& File : InCommand.Files)
 	{
-		if (State->IsDeleted())
+		FFriendshipperState State;
+		if (Provider.GetCachedState(File, State) && State.FileState == EFileState::Deleted)
 		{
-			Provider.RemoveFileFromCache(State->GetFilename());
+			Provider.RemoveFileFromCache(File);
 		}
 	}
 	Operation->SetSuccessMessage(FText::FromString("Commit successful!"));
 	FriendshipperSourceControlUtils::GetCommitInfo(InCommand.PathToGitBinary, InCommand.PathToRepositoryRoot, InCommand.CommitId, InCommand.CommitSummary);
 
 	// now update the status of our files
-	TMap<FString, FFriendshipperSourceControlState> UpdatedStates;
+	TMap<FFriendshipperPathId, FFriendshipperState> UpdatedStates;
 	bool bSuccess = FriendshipperSourceControlUtils::RunUpdateStatus(InCommand.PathToRepositoryRoot, InCommand.Files, EForceStatusRefresh::False, UpdatedStates);
 	if (bSuccess)
 	{
-		FriendshipperSourceControlUtils::CollectNewStates(UpdatedStates, States);
+		States.Append(UpdatedStates);
 	}
 	FriendshipperSourceControlUtils::RemoveRedundantErrors(InCommand, TEXT("' is outside repository"));
 	return true;
@@ -353,8 +421,7 @@ bool FFriendshipperFetchWorker::Execute(FFriendshipperSourceControlCommand& InCo
 		FRepoStatus RepoStatus;
 		if (Client.GetStatus(EForceStatusRefresh::True, RepoStatus))
 		{
-			TSet<FString> AllFiles = Provider.GetAllPathsAbsolute();
-			States = FriendshipperSourceControlUtils::FriendshipperStatesFromRepoStatus(InCommand.PathToRepositoryRoot, AllFiles, RepoStatus);
+			StatusUpdate = Provider.ComputeStatusUpdate(MakeShared<const FFriendshipperRepoStatusIndex, ESPMode::ThreadSafe>(InCommand.PathToRepositoryRoot, RepoStatus));
 		}
 	}
 
@@ -363,7 +430,8 @@ bool FFriendshipperFetchWorker::Execute(FFriendshipperSourceControlCommand& InCo
 
 bool FFriendshipperFetchWorker::UpdateStates() const
 {
-	return FriendshipperSourceControlUtils::UpdateCachedStates(States);
+	FFriendshipperSourceControlProvider& Provider = FFriendshipperSourceControlModule::Get().GetProvider();
+	return Provider.ApplyStatusUpdate(StatusUpdate);
 }
 
 FName FFriendshipperUpdateStatusWorker::GetName() const
@@ -380,20 +448,26 @@ bool FFriendshipperUpdateStatusWorker::Execute(FFriendshipperSourceControlComman
 	bool bSuccess = true;
 	if(InCommand.Files.Num() > 0)
 	{
-		TMap<FString, FFriendshipperSourceControlState> UpdatedStates;
+		TMap<FFriendshipperPathId, FFriendshipperState> UpdatedStates;
 		bSuccess = FriendshipperSourceControlUtils::RunUpdateStatus(InCommand.PathToRepositoryRoot, InCommand.Files, EForceStatusRefresh::False, UpdatedStates);
 		FriendshipperSourceControlUtils::RemoveRedundantErrors(InCommand, TEXT("' is outside repository"));
 		if (bSuccess)
 		{
-			FriendshipperSourceControlUtils::CollectNewStates(UpdatedStates, States);
+			States.Append(UpdatedStates);
 			if (Operation->ShouldUpdateHistory())
 			{
 				for (const auto& State : UpdatedStates)
 				{
-					const FString& File = State.Key;
+					if (InCommand.IsCanceled())
+					{
+						bSuccess = false;
+						break;
+					}
+
+					const FString File = FFriendshipperPathTable::Get().GetPath(State.Key);
 					TGitSourceControlHistory History;
 
-					if (State.Value.IsConflicted())
+					if (State.Value.FileState == EFileState::Unmerged)
 					{
 						// In case of a merge conflict, we first need to get the tip of the "remote branch" (MERGE_HEAD)
 						FriendshipperSourceControlUtils::RunGetHistory(InCommand.PathToGitBinary, InCommand.PathToRepositoryRoot, File, true,
@@ -412,12 +486,12 @@ bool FFriendshipperUpdateStatusWorker::Execute(FFriendshipperSourceControlComman
 		// no path provided: only update the status of assets in Content/ directory and also Config files
 		const TArray<FString> ProjectDirs {FPaths::ConvertRelativePathToFull(FPaths::ProjectContentDir()), FPaths::ConvertRelativePathToFull(FPaths::ProjectConfigDir()),
 										   FPaths::ConvertRelativePathToFull(FPaths::GetProjectFilePath())};
-		TMap<FString, FFriendshipperSourceControlState> UpdatedStates;
+		TMap<FFriendshipperPathId, FFriendshipperState> UpdatedStates;
 		bSuccess = FriendshipperSourceControlUtils::RunUpdateStatus(InCommand.PathToRepositoryRoot, ProjectDirs, EForceStatusRefresh::False, UpdatedStates);
 		FriendshipperSourceControlUtils::RemoveRedundantErrors(InCommand, TEXT("' is outside repository"));
 		if (bSuccess)
 		{
-			FriendshipperSourceControlUtils::CollectNewStates(UpdatedStates, States);
+			States.Append(UpdatedStates);
 		}
 	}
 
@@ -438,9 +512,7 @@ bool FFriendshipperUpdateStatusWorker::UpdateStates() const
 	// add history, if any
 	for(const auto& History : Histories)
 	{
-		TSharedRef<FFriendshipperSourceControlState, ESPMode::ThreadSafe> State = Provider.GetStateInternal(History.Key);
-		State->History = History.Value;
-		State->TimeStamp = FDateTime::Now();
+		Provider.UpdateCachedHistory(FFriendshipperPathTable::Get().Intern(History.Key), History.Value);
 		bUpdated = true;
 	}
 
@@ -488,10 +560,10 @@ bool FFriendshipperResolveWorker::Execute( class FFriendshipperSourceControlComm
 	const bool bSuccess = FriendshipperSourceControlUtils::RunCommand(TEXT("add"), InCommand.PathToGitBinary, InCommand.PathToRepositoryRoot, FFriendshipperSourceControlModule::GetEmptyStringArray(), InCommand.Files, Results, InCommand.ResultInfo.ErrorMessages);
 
 	// now update the status of our files
-	TMap<FString, FFriendshipperSourceControlState> UpdatedStates;
+	TMap<FFriendshipperPathId, FFriendshipperState> UpdatedStates;
 	if (FriendshipperSourceControlUtils::RunUpdateStatus(InCommand.PathToRepositoryRoot, InCommand.Files, EForceStatusRefresh::False, UpdatedStates))
 	{
-		FriendshipperSourceControlUtils::CollectNewStates(UpdatedStates, States);
+		States.Append(UpdatedStates);
 	}
 
 	FriendshipperSourceControlUtils::RemoveRedundantErrors(InCommand, TEXT("' is outside repository"));
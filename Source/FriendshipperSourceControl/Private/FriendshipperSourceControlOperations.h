@@ -7,6 +7,7 @@
 
 #include "CoreMinimal.h"
 #include "IFriendshipperSourceControlWorker.h"
+#include "FriendshipperRepoStatusIndex.h"
 #include "FriendshipperSourceControlState.h"
 
 #include "ISourceControlOperation.h"
@@ -37,7 +38,7 @@ public:
 	virtual bool UpdateStates() const override;
 
 	/** Temporary states for results */
-	TMap<const FString, FFriendshipperState> States;
+	TMap<FFriendshipperPathId, FFriendshipperState> States;
 };
 
 /** Lock (check-out) a set of files using Git LFS 2. */
@@ -51,7 +52,7 @@ public:
 	virtual bool UpdateStates() const override;
 
 	/** Temporary states for results */
-	TMap<const FString, FFriendshipperState> States;
+	TMap<FFriendshipperPathId, FFriendshipperState> States;
 };
 
 /** Commit (check-in) a set of files to the local depot. */
@@ -65,7 +66,7 @@ public:
 	virtual bool UpdateStates() const override;
 
 	/** Temporary states for results */
-	TMap<const FString, FFriendshipperState> States;
+	TMap<FFriendshipperPathId, FFriendshipperState> States;
 };
 
 /** Add an untracked file to revision control (so only a subset of the git add command). */
@@ -79,7 +80,7 @@ public:
 	virtual bool UpdateStates() const override;
 
 	/** Temporary states for results */
-	TMap<const FString, FFriendshipperState> States;
+	TMap<FFriendshipperPathId, FFriendshipperState> States;
 };
 
 /** Delete a file and remove it from revision control. */
@@ -93,7 +94,7 @@ public:
 	virtual bool UpdateStates() const override;
 
 	/** Temporary states for results */
-	TMap<const FString, FFriendshipperState> States;
+	TMap<FFriendshipperPathId, FFriendshipperState> States;
 };
 
 /** Revert any change to a file to its state on the local depot. */
@@ -107,7 +108,7 @@ public:
 	virtual bool UpdateStates() const override;
 
 	/** Temporary states for results */
-	TMap<const FString, FFriendshipperState> States;
+	TMap<FFriendshipperPathId, FFriendshipperState> States;
 };
 
 /** Get revision control status of files on local working copy. */
@@ -122,7 +123,7 @@ public:
 
 public:
 	/** Temporary states for results */
-	TMap<const FString, FFriendshipperState> States;
+	TMap<FFriendshipperPathId, FFriendshipperState> States;
 
 	/** Map of filenames to history */
 	TMap<FString, TGitSourceControlHistory> Histories;
@@ -139,7 +140,7 @@ public:
 	virtual bool UpdateStates() const override;
 
 	/** Temporary states for results */
-	TMap<const FString, FFriendshipperState> States;
+	TMap<FFriendshipperPathId, FFriendshipperState> States;
 };
 
 /** git add to mark a conflict as resolved */
@@ -152,7 +153,7 @@ public:
 	virtual bool UpdateStates() const override;
 
 	/** Temporary states for results */
-	TMap<const FString, FFriendshipperState> States;
+	TMap<FFriendshipperPathId, FFriendshipperState> States;
 };
 
 /** Git push to publish branch for its configured remote */
@@ -165,6 +166,6 @@ public:
 	virtual bool Execute(class FFriendshipperSourceControlCommand& InCommand) override;
 	virtual bool UpdateStates() const override;
 
-	/** Temporary states for results */
-	TMap<const FString, FFriendshipperState> States;
+	/** States that changed since the last applied status */
+	FFriendshipperStatusUpdate StatusUpdate;
 };
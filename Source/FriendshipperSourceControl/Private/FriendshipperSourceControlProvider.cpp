@@ -6,7 +6,10 @@
 #include "FriendshipperSourceControlProvider.h"
 
 #include "FriendshipperMessageLog.h"
+#include "FriendshipperGitAttributes.h"
+#include "FriendshipperRepoStatusIndex.h"
 #include "FriendshipperSourceControlState.h"
+#include "FriendshipperStateCacheFile.h"
 #include "Misc/Paths.h"
 #include "Misc/QueuedThreadPool.h"
 #include "FriendshipperSourceControlCommand.h"
@@ -21,6 +24,7 @@
 #include "Async/Async.h"
 #include "GenericPlatform/GenericPlatformFile.h"
 #include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
 #include "Interfaces/IPluginManager.h"
 #include "Misc/App.h"
 #include "Misc/EngineVersion.h"
@@ -34,6 +38,62 @@
 
 #define LOCTEXT_NAMESPACE "GitSourceControl"
 
+static TAutoConsoleVariable<bool> CVarIndexedStateQueries(
+	TEXT("Friendshipper.IndexedStateQueries"),
+	false,
+	TEXT("Only consider files with pending work (modified, added, deleted, locked, not at head...) in GetCachedStateByPredicate, through the state cache indexes, instead of every cached file. ")
+	TEXT("Narrows what the query returns: predicates accepting clean files, eg. IsSourceControlled(), miss every unmodified, unlocked, up to date file. Off by default, at the cost of a state object for most files of the repository on every query."));
+
+static TAutoConsoleVariable<float> CVarIgnoreForceUpdateSeconds(
+	TEXT("Friendshipper.IgnoreForceUpdateSeconds"),
+	5.0f,
+	TEXT("For how long after a file's state was updated a forced status update of that file is skipped."));
+
+static TAutoConsoleVariable<float> CVarCoalesceUpdateStatusSeconds(
+	TEXT("Friendshipper.CoalesceUpdateStatusSeconds"),
+	0.1f,
+	TEXT("Asynchronous UpdateStatus operations issued within this delay of each other are merged into a single status query. 0 to run each on its own."));
+
+static TAutoConsoleVariable<bool> CVarAsyncForceUpdate(
+	TEXT("Friendshipper.AsyncForceUpdate"),
+	false,
+	TEXT("GetState with ForceUpdate returns the cached states immediately and refreshes them in the background, instead of waiting for the refresh."));
+
+static TAutoConsoleVariable<int32> CVarDeferredStatesThreshold(
+	TEXT("Friendshipper.DeferredStatesThreshold"),
+	2000,
+	TEXT("Results with more states than this are applied to the cache over several ticks, see Friendshipper.StateApplyBudgetMs."));
+
+static TAutoConsoleVariable<float> CVarStateApplyBudgetMs(
+	TEXT("Friendshipper.StateApplyBudgetMs"),
+	4.0f,
+	TEXT("Time spent applying deferred states per tick, in milliseconds. Files queried through GetState are applied first. 0 to apply all results at once."));
+
+static TAutoConsoleVariable<float> CVarCommandCompletionBudgetMs(
+	TEXT("Friendshipper.CommandCompletionBudgetMs"),
+	5.0f,
+	TEXT("Time spent per tick delivering the results of completed commands, in milliseconds. At least one command is delivered per tick."));
+
+static TAutoConsoleVariable<int32> CVarInteractiveCommandThreads(
+	TEXT("Friendshipper.InteractiveCommandThreads"),
+	2,
+	TEXT("Number of threads running operations on files (check out, revert, status of given files...). Read when the thread pool is created."));
+
+static TAutoConsoleVariable<int32> CVarBackgroundCommandThreads(
+	TEXT("Friendshipper.BackgroundCommandThreads"),
+	1,
+	TEXT("Number of threads running whole project status refreshes and history fetches. Read when the thread pool is created."));
+
+static TAutoConsoleVariable<int32> CVarSynchronousWaitPumpMs(
+	TEXT("Friendshipper.SynchronousWaitPumpMs"),
+	5,
+	TEXT("While waiting for a synchronous command, interval at which the HTTP manager and server are ticked, in milliseconds. The wait itself ends as soon as the command completes."));
+
+static TAutoConsoleVariable<bool> CVarPersistentStateCache(
+	TEXT("Friendshipper.PersistentStateCache"),
+	true,
+	TEXT("Save the file states to Saved/Friendshipper/StateCache.bin on shutdown, and show them on startup until the first status is received."));
+
 static FName ProviderName("Friendshipper");
 
 void FFriendshipperSourceControlProvider::Init(bool bUnusedForceConnection)
@@ -118,6 +178,12 @@ void FFriendshipperSourceControlProvider::CheckRepositoryStatus()
 		return;
 	}
 
+	// Show the states of the previous session while waiting for the Friendshipper status
+	if (LoadSavedStates())
+	{
+		bGitRepositoryFound = true;
+	}
+
 	TUniqueFunction<void()> InitFunc = [this]()
 	{
 		if (!IsInGameThread())
@@ -144,15 +210,7 @@ void FFriendshipperSourceControlProvider::CheckRepositoryStatus()
 			FriendshipperSourceControlUtils::GetRemoteBranchName(PathToGitBinary, PathToRepositoryRoot, RemoteBranchName);
 			FriendshipperSourceControlUtils::GetRemoteUrl(PathToGitBinary, PathToRepositoryRoot, RemoteUrl);
 
-			const TArray<FString> Files{ TEXT("*.uasset"), TEXT("*.umap") };
-			TArray<FString> LockableErrorMessages;
-			if (!FriendshipperSourceControlUtils::CheckLFSLockable(PathToGitBinary, PathToRepositoryRoot, Files, LockableErrorMessages))
-			{
-				for (const auto& ErrorMessage : LockableErrorMessages)
-				{
-					UE_LOG(LogSourceControl, Error, TEXT("%s"), *ErrorMessage);
-				}
-			}
+			FriendshipperSourceControlUtils::LoadGitAttributes(PathToGitBinary, PathToRepositoryRoot);
 
 			FRepoStatus UnusedStatus;
 			return FriendshipperClient.GetStatus(EForceStatusRefresh::True, UnusedStatus);
@@ -237,8 +295,32 @@ void FFriendshipperSourceControlProvider::Close()
 		}
 	}
 
+	ApplyDeferredStates(0.0);
+	SaveStates();
+
+	// Requests still waiting to be merged will never run
+	for (FFriendshipperCoalescedUpdateStatus* Batch : { &CoalescedFilesStatus, &CoalescedProjectStatus })
+	{
+		const TArray<TPair<FSourceControlOperationRef, FSourceControlOperationComplete>> Requests = MoveTemp(Batch->Requests);
+		*Batch = FFriendshipperCoalescedUpdateStatus();
+		for (const TPair<FSourceControlOperationRef, FSourceControlOperationComplete>& Request : Requests)
+		{
+			Request.Value.ExecuteIfBound(Request.Key, ECommandResult::Cancelled);
+		}
+	}
+
 	// clear the cache
 	StateCache.Empty();
+	PendingChangedPaths.Empty();
+	IgnoreForceCache.Empty();
+	DeferredStates.Empty();
+	SavedStatePaths.Empty();
+	SavedPaths.Reset();
+	{
+		FScopeLock Lock(&AppliedStatusCriticalSection);
+		AppliedStatusIndex.Reset();
+	}
+	PathsUpdatedSinceAppliedStatus.Empty();
 	// Remove all extensions to the "Revision Control" menu in the Editor Toolbar
 	GitSourceControlMenu.Unregister();
 
@@ -250,19 +332,19 @@ void FFriendshipperSourceControlProvider::Close()
 
 TSharedRef<FFriendshipperSourceControlState, ESPMode::ThreadSafe> FFriendshipperSourceControlProvider::GetStateInternal(const FString& Filename)
 {
-	TSharedRef<FFriendshipperSourceControlState, ESPMode::ThreadSafe>* State = StateCache.Find(Filename);
-	if (State != NULL)
-	{
-		// found cached item
-		return (*State);
-	}
-	else
-	{
-		// cache an unknown state for this item
-		TSharedRef<FFriendshipperSourceControlState, ESPMode::ThreadSafe> NewState = MakeShareable(new FFriendshipperSourceControlState(Filename));
-		StateCache.Add(Filename, NewState);
-		return NewState;
-	}
+	return GetStateInternal(FFriendshipperPathTable::Get().Intern(Filename));
+}
+
+TSharedRef<FFriendshipperSourceControlState, ESPMode::ThreadSafe> FFriendshipperSourceControlProvider::GetStateInternal(const FFriendshipperPathId Path)
+{
+	// cache an unknown state for this item if it isn't cached yet
+	return StateCache.FindOrAdd(Path);
+}
+
+bool FFriendshipperSourceControlProvider::GetCachedState(const FString& Filename, FFriendshipperState& OutState) const
+{
+	const FFriendshipperPathId Path = FFriendshipperPathTable::Get().Find(Filename);
+	return Path.IsValid() && StateCache.CopyState(Path, OutState);
 }
 
 FText FFriendshipperSourceControlProvider::GetStatusText() const
@@ -310,6 +392,11 @@ const FName& FFriendshipperSourceControlProvider::GetName(void) const
 }
 
 ECommandResult::Type FFriendshipperSourceControlProvider::GetState(const TArray<FString>& InFiles, TArray<TSharedRef<ISourceControlState, ESPMode::ThreadSafe>>& OutState, EStateCacheUsage::Type InStateCacheUsage)
+{
+	return GetState(InFiles, OutState, InStateCacheUsage, CVarAsyncForceUpdate.GetValueOnGameThread() ? EConcurrency::Asynchronous : EConcurrency::Synchronous);
+}
+
+ECommandResult::Type FFriendshipperSourceControlProvider::GetState(const TArray<FString>& InFiles, TArray<FSourceControlStateRef>& OutState, EStateCacheUsage::Type InStateCacheUsage, EConcurrency::Type InForceUpdateConcurrency)
 {
 	if (!IsEnabled())
 	{
@@ -330,12 +417,16 @@ ECommandResult::Type FFriendshipperSourceControlProvider::GetState(const TArray<
 		}
 		if (ForceUpdate.Num() > 0)
 		{
-			Execute(ISourceControlOperation::Create<FUpdateStatus>(), ForceUpdate);
+			// Asynchronous updates are coalesced with the other pending ones, and broadcast the files whose state changed
+			Execute(ISourceControlOperation::Create<FUpdateStatus>(), ForceUpdate, InForceUpdateConcurrency);
 		}
 	}
 
 	const TArray<FString>& AbsoluteFiles = SourceControlHelpers::AbsoluteFilenames(InFiles);
 
+	// Queried files are visible or selected in the editor: don't make them wait for their turn
+	ApplyDeferredStates(AbsoluteFiles);
+
 	for (TArray<FString>::TConstIterator It(AbsoluteFiles); It; It++)
 	{
 		OutState.Add(GetStateInternal(*It));
@@ -351,10 +442,23 @@ ECommandResult::Type FFriendshipperSourceControlProvider::GetState(const TArray<
 
 TArray<FSourceControlStateRef> FFriendshipperSourceControlProvider::GetCachedStateByPredicate(TFunctionRef<bool(const FSourceControlStateRef&)> Predicate) const
 {
+	return FilterCachedStates(Predicate, CVarIndexedStateQueries.GetValueOnAnyThread());
+}
+
+TArray<FSourceControlStateRef> FFriendshipperSourceControlProvider::GetPendingStateByPredicate(TFunctionRef<bool(const FSourceControlStateRef&)> Predicate) const
+{
+	return FilterCachedStates(Predicate, true);
+}
+
+TArray<FSourceControlStateRef> FFriendshipperSourceControlProvider::FilterCachedStates(TFunctionRef<bool(const FSourceControlStateRef&)> Predicate, const bool bInPendingOnly) const
+{
+	// Gather the states first, so that the predicate doesn't run under the cache locks
+	TArray<FFriendshipperStateCache::FStateRef> States;
+	StateCache.GetStateObjects(bInPendingOnly, States);
+
 	TArray<FSourceControlStateRef> Result;
-	for (const auto& CacheItem : StateCache)
+	for (const FSourceControlStateRef& State : States)
 	{
-		const FSourceControlStateRef& State = CacheItem.Value;
 		if (Predicate(State))
 		{
 			Result.Add(State);
@@ -365,27 +469,59 @@ TArray<FSourceControlStateRef> FFriendshipperSourceControlProvider::GetCachedSta
 
 bool FFriendshipperSourceControlProvider::RemoveFileFromCache(const FString& Filename)
 {
-	return StateCache.Remove(Filename) > 0;
+	const FFriendshipperPathId Path = FFriendshipperPathTable::Get().Find(Filename);
+	return Path.IsValid() && StateCache.Remove(Path);
 }
 
 bool FFriendshipperSourceControlProvider::AddFileToIgnoreForceCache(const FString& Filename)
 {
-	return IgnoreForceCache.Add(Filename) > 0;
+	IgnoreForceCache.Add(FFriendshipperPathTable::Get().Intern(Filename), FPlatformTime::Seconds() + CVarIgnoreForceUpdateSeconds.GetValueOnAnyThread());
+	return true;
 }
 
 bool FFriendshipperSourceControlProvider::RemoveFileFromIgnoreForceCache(const FString& Filename)
 {
-	return IgnoreForceCache.Remove(Filename) > 0;
+	const FFriendshipperPathId Path = FFriendshipperPathTable::Get().Find(Filename);
+
+	double Expiry = 0.0;
+	if (!Path.IsValid() || !IgnoreForceCache.RemoveAndCopyValue(Path, Expiry))
+	{
+		return false;
+	}
+
+	// Past its expiry, the entry no longer stands for a recent update
+	return FPlatformTime::Seconds() < Expiry;
+}
+
+void FFriendshipperSourceControlProvider::PruneIgnoreForceCache()
+{
+	const double Now = FPlatformTime::Seconds();
+	if (Now < NextIgnoreForceCachePrune)
+	{
+		return;
+	}
+	NextIgnoreForceCachePrune = Now + CVarIgnoreForceUpdateSeconds.GetValueOnGameThread();
+
+	for (auto It = IgnoreForceCache.CreateIterator(); It; ++It)
+	{
+		if (It.Value() <= Now)
+		{
+			It.RemoveCurrent();
+		}
+	}
 }
 
 /** Get files in cache */
 TArray<FString> FFriendshipperSourceControlProvider::GetFilesInCache()
 {
+	const FFriendshipperPathTable& PathTable = FFriendshipperPathTable::Get();
+
 	TArray<FString> Files;
-	for (const auto& State : StateCache)
-	{
-		Files.Add(State.Key);
-	}
+	Files.Reserve(StateCache.Num());
+	StateCache.ForEach([&Files, &PathTable](const FFriendshipperPathId Path, const FFriendshipperCachedState&)
+		{
+			Files.Add(PathTable.GetPath(Path));
+		});
 	return Files;
 }
 
@@ -399,6 +535,16 @@ void FFriendshipperSourceControlProvider::UnregisterSourceControlStateChanged_Ha
 	OnSourceControlStateChanged.Remove(Handle);
 }
 
+FDelegateHandle FFriendshipperSourceControlProvider::RegisterStatesChanged_Handle(const FFriendshipperStatesChanged::FDelegate& StatesChanged)
+{
+	return OnStatesChanged.Add(StatesChanged);
+}
+
+void FFriendshipperSourceControlProvider::UnregisterStatesChanged_Handle(FDelegateHandle Handle)
+{
+	OnStatesChanged.Remove(Handle);
+}
+
 ECommandResult::Type FFriendshipperSourceControlProvider::Execute(const FSourceControlOperationRef& InOperation, FSourceControlChangelistPtr InChangelist, const TArray<FString>& InFiles, EConcurrency::Type InConcurrency, const FSourceControlOperationComplete& InOperationCompleteDelegate)
 {
 	if (!IsEnabled() && !(InOperation->GetName() == "Connect")) // Only Connect operation allowed while not Enabled (Repository found)
@@ -409,6 +555,11 @@ ECommandResult::Type FFriendshipperSourceControlProvider::Execute(const FSourceC
 
 	const TArray<FString>& AbsoluteFiles = SourceControlHelpers::AbsoluteFilenames(InFiles);
 
+	if (InConcurrency == EConcurrency::Asynchronous && CoalesceUpdateStatus(InOperation, AbsoluteFiles, InOperationCompleteDelegate))
+	{
+		return ECommandResult::Succeeded;
+	}
+
 	// Query to see if we allow this operation
 	TSharedPtr<IFriendshipperSourceControlWorker, ESPMode::ThreadSafe> Worker = CreateWorker(InOperation->GetName());
 	if (!Worker.IsValid())
@@ -452,20 +603,95 @@ ECommandResult::Type FFriendshipperSourceControlProvider::Execute(const FSourceC
 	}
 }
 
+bool FFriendshipperSourceControlProvider::CoalesceUpdateStatus(const FSourceControlOperationRef& InOperation, const TArray<FString>& InFiles, const FSourceControlOperationComplete& InOperationCompleteDelegate)
+{
+	const float Window = CVarCoalesceUpdateStatusSeconds.GetValueOnGameThread();
+	if (Window <= 0.0f || InOperation->GetName() != "UpdateStatus" || !WorkersMap.Contains(InOperation->GetName()))
+	{
+		return false;
+	}
+
+	// History is fetched per file, leave these to their own command
+	if (StaticCastSharedRef<FUpdateStatus>(InOperation)->ShouldUpdateHistory())
+	{
+		return false;
+	}
+
+	FFriendshipperCoalescedUpdateStatus& Batch = InFiles.IsEmpty() ? CoalescedProjectStatus : CoalescedFilesStatus;
+	if (Batch.Requests.IsEmpty())
+	{
+		Batch.IssueTime = FPlatformTime::Seconds() + Window;
+	}
+	Batch.Files.Append(InFiles);
+	Batch.Requests.Emplace(InOperation, InOperationCompleteDelegate);
+	return true;
+}
+
+void FFriendshipperSourceControlProvider::IssueCoalescedUpdateStatus(FFriendshipperCoalescedUpdateStatus& InOutBatch)
+{
+	FFriendshipperCoalescedUpdateStatus Batch = MoveTemp(InOutBatch);
+	InOutBatch = FFriendshipperCoalescedUpdateStatus();
+
+#if UE_BUILD_DEBUG
+	UE_LOG(LogSourceControl, Log, TEXT("IssueAsynchronousCommand(UpdateStatus) for %d coalesced requests on %d files"), Batch.Requests.Num(), Batch.Files.Num());
+#endif
+
+	const FSourceControlOperationRef Operation = ISourceControlOperation::Create<FUpdateStatus>();
+	FFriendshipperSourceControlCommand* Command = new FFriendshipperSourceControlCommand(Operation, CreateWorker(Operation->GetName()).ToSharedRef());
+	Command->Files = Batch.Files.Array();
+	Command->UpdateRepositoryRootIfSubmodule(Command->Files);
+	Command->bAutoDelete = true;
+
+	// Every request not cancelled meanwhile gets the messages and the result of the merged command
+	const TSharedRef<TArray<TPair<FSourceControlOperationRef, FSourceControlOperationComplete>>> Requests = MakeShared<TArray<TPair<FSourceControlOperationRef, FSourceControlOperationComplete>>>(MoveTemp(Batch.Requests));
+	CoalescedStatusInFlight.Add(Command, Requests);
+	Command->OperationCompleteDelegate = FSourceControlOperationComplete::CreateLambda([this, Command, Requests](const FSourceControlOperationRef& InOperation, ECommandResult::Type InResult)
+		{
+			CoalescedStatusInFlight.Remove(Command);
+			for (const TPair<FSourceControlOperationRef, FSourceControlOperationComplete>& Request : *Requests)
+			{
+				for (const FText& Message : InOperation->GetResultInfo().InfoMessages)
+				{
+					Request.Key->AddInfoMessge(Message);
+				}
+				for (const FText& Message : InOperation->GetResultInfo().ErrorMessages)
+				{
+					Request.Key->AddErrorMessge(Message);
+				}
+				Request.Value.ExecuteIfBound(Request.Key, InResult);
+			}
+		});
+
+	IssueCommand(*Command);
+}
+
 bool FFriendshipperSourceControlProvider::CanCancelOperation(const FSourceControlOperationRef& InOperation) const
 {
-	// TODO: maybe support cancellation again?
-#if 0
+	auto IsRequest = [&InOperation](const TPair<FSourceControlOperationRef, FSourceControlOperationComplete>& Request)
+	{
+		return Request.Key == InOperation;
+	};
+	if (CoalescedFilesStatus.Requests.ContainsByPredicate(IsRequest) || CoalescedProjectStatus.Requests.ContainsByPredicate(IsRequest))
+	{
+		return true;
+	}
+	for (const TPair<FFriendshipperSourceControlCommand*, TSharedRef<TArray<TPair<FSourceControlOperationRef, FSourceControlOperationComplete>>>>& InFlight : CoalescedStatusInFlight)
+	{
+		if (InFlight.Value->ContainsByPredicate(IsRequest))
+		{
+			return true;
+		}
+	}
+
 	for (int32 CommandIndex = 0; CommandIndex < CommandQueue.Num(); ++CommandIndex)
 	{
 		const FFriendshipperSourceControlCommand& Command = *CommandQueue[CommandIndex];
 		if (Command.Operation == InOperation)
 		{
-			check(Command.bAutoDelete);
-			return true;
+			// Synchronous commands are cancelled from their progress dialog
+			return Command.bAutoDelete && !Command.IsCanceled();
 		}
 	}
-#endif
 
 	// operation was not in progress!
 	return false;
@@ -473,6 +699,44 @@ bool FFriendshipperSourceControlProvider::CanCancelOperation(const FSourceContro
 
 void FFriendshipperSourceControlProvider::CancelOperation(const FSourceControlOperationRef& InOperation)
 {
+	for (FFriendshipperCoalescedUpdateStatus* Batch : { &CoalescedFilesStatus, &CoalescedProjectStatus })
+	{
+		const int32 RequestIndex = Batch->Requests.IndexOfByPredicate([&InOperation](const TPair<FSourceControlOperationRef, FSourceControlOperationComplete>& Request)
+			{
+				return Request.Key == InOperation;
+			});
+		if (RequestIndex != INDEX_NONE)
+		{
+			// Its files stay in the batch, querying a few more files is cheaper than rebuilding the union
+			const FSourceControlOperationComplete Delegate = Batch->Requests[RequestIndex].Value;
+			Batch->Requests.RemoveAt(RequestIndex);
+			Delegate.ExecuteIfBound(InOperation, ECommandResult::Cancelled);
+			return;
+		}
+	}
+
+	for (const TPair<FFriendshipperSourceControlCommand*, TSharedRef<TArray<TPair<FSourceControlOperationRef, FSourceControlOperationComplete>>>>& InFlight : CoalescedStatusInFlight)
+	{
+		TArray<TPair<FSourceControlOperationRef, FSourceControlOperationComplete>>& Requests = *InFlight.Value;
+		const int32 RequestIndex = Requests.IndexOfByPredicate([&InOperation](const TPair<FSourceControlOperationRef, FSourceControlOperationComplete>& Request)
+			{
+				return Request.Key == InOperation;
+			});
+		if (RequestIndex != INDEX_NONE)
+		{
+			// The merged command keeps running for the other requests, and stops once none is left
+			FFriendshipperSourceControlCommand* Command = InFlight.Key;
+			const FSourceControlOperationComplete Delegate = Requests[RequestIndex].Value;
+			Requests.RemoveAt(RequestIndex);
+			if (Requests.IsEmpty())
+			{
+				Command->Cancel();
+			}
+			Delegate.ExecuteIfBound(InOperation, ECommandResult::Cancelled);
+			return;
+		}
+	}
+
 	for (int32 CommandIndex = 0; CommandIndex < CommandQueue.Num(); ++CommandIndex)
 	{
 		FFriendshipperSourceControlCommand& Command = *CommandQueue[CommandIndex];
@@ -597,67 +861,108 @@ void FFriendshipperSourceControlProvider::UpdateRepositoryStatus(const class FFr
 
 void FFriendshipperSourceControlProvider::Tick()
 {
+	// Forced updates only ask listeners to requery, they don't change any state
 	bool bStatesUpdated = TicksUntilNextForcedUpdate == 1;
 	if (TicksUntilNextForcedUpdate > 0)
 	{
 		--TicksUntilNextForcedUpdate;
 	}
 
-	for (int32 CommandIndex = 0; CommandIndex < CommandQueue.Num(); ++CommandIndex)
+	const double Now = FPlatformTime::Seconds();
+	for (FFriendshipperCoalescedUpdateStatus* Batch : { &CoalescedFilesStatus, &CoalescedProjectStatus })
 	{
-		FFriendshipperSourceControlCommand& Command = *CommandQueue[CommandIndex];
-
-		if (Command.bExecuteProcessed)
+		if (!Batch->Requests.IsEmpty() && Now >= Batch->IssueTime)
 		{
-			// Remove command from the queue
-			CommandQueue.RemoveAt(CommandIndex);
-
-			if (!Command.IsCanceled())
-			{
-				// Update repository status on UpdateStatus operations
-				UpdateRepositoryStatus(Command);
-			}
-
-			// let command update the states of any files
-			bStatesUpdated |= Command.Worker->UpdateStates();
+			IssueCoalescedUpdateStatus(*Batch);
+		}
+	}
 
-			// dump any messages to output log
-			OutputCommandMessages(Command);
+	// Cancelled commands return their results once, right away, then are deleted when their thread finally finishes
+	TArray<FFriendshipperSourceControlCommand*, TInlineAllocator<4>> CancelledCommands;
+	for (FFriendshipperSourceControlCommand* Command : CommandQueue)
+	{
+		if (Command->IsCanceled() && !Command->bCancelledResultsReturned)
+		{
+			CancelledCommands.Add(Command);
+		}
+	}
+	auto Start = [this](FFriendshipperSourceControlCommand& Command) { StartCommand(Command); };
+	for (FFriendshipperSourceControlCommand* Command : CancelledCommands)
+	{
+		// If this was a synchronous command, set it free so that it will be deleted automatically
+		Command->bAutoDelete = true;
+		Command->bCancelledResultsReturned = true;
+		Command->ReturnResults();
 
-			// run the completion delegate callback if we have one bound
-			if (!Command.IsCanceled())
-			{
-				Command.ReturnResults();
-			}
+		// A command still waiting for its files never started, and will never complete
+		if (CommandScheduler.RemoveWaiting(*Command, Start))
+		{
+			CommandQueue.RemoveSingle(Command);
+			delete Command;
+		}
+	}
 
-			// commands that are left in the array during a tick need to be deleted
-			if (Command.bAutoDelete)
-			{
-				// Only delete commands that are not running 'synchronously'
-				delete &Command;
-			}
+	// Deliver as many completed commands as the budget allows, at least one. Completion delegates can issue new
+	// commands, or tick again from a synchronous one: each command is out of the queue before being processed.
+	const double CompletionEndTime = FPlatformTime::Seconds() + CVarCommandCompletionBudgetMs.GetValueOnGameThread() / 1000.0;
+	FFriendshipperSourceControlCommand* Completed = nullptr;
+	while (CompletedCommands.Dequeue(Completed))
+	{
+		CommandQueue.RemoveSingle(Completed);
+		CommandScheduler.Complete(*Completed, Start);
+		bStatesUpdated |= ProcessCompletedCommand(*Completed);
 
-			// only do one command per tick loop, as we dont want concurrent modification
-			// of the command queue (which can happen in the completion delegate)
-			break;
-		}
-		else if (Command.bCancelled)
+		if (FPlatformTime::Seconds() >= CompletionEndTime)
 		{
-			// If this was a synchronous command, set it free so that it will be deleted automatically
-			// when its (still running) thread finally finishes
-			Command.bAutoDelete = true;
-
-			Command.ReturnResults();
 			break;
 		}
 	}
 
+	// Large results land a slice per tick, each broadcast with this tick's change set
+	ApplyDeferredStates(CVarStateApplyBudgetMs.GetValueOnGameThread() / 1000.0);
+
+	// Only notify listeners when a state actually changed
+	bStatesUpdated |= BroadcastStateChanges();
+
+	PruneIgnoreForceCache();
+
 	if (bStatesUpdated)
 	{
 		OnSourceControlStateChanged.Broadcast();
 	}
 }
 
+bool FFriendshipperSourceControlProvider::ProcessCompletedCommand(FFriendshipperSourceControlCommand& InCommand)
+{
+	InCommand.bCompletionProcessed = true;
+
+	if (!InCommand.IsCanceled())
+	{
+		// Update repository status on UpdateStatus operations
+		UpdateRepositoryStatus(InCommand);
+	}
+
+	// let command update the states of any files
+	const bool bStatesUpdated = InCommand.Worker->UpdateStates();
+
+	// dump any messages to output log
+	OutputCommandMessages(InCommand);
+
+	// run the completion delegate callback if we have one bound, cancelled commands already did
+	if (!InCommand.IsCanceled())
+	{
+		InCommand.ReturnResults();
+	}
+
+	if (InCommand.bAutoDelete)
+	{
+		// Only delete commands that are not running 'synchronously'
+		delete &InCommand;
+	}
+
+	return bStatesUpdated;
+}
+
 TArray<TSharedRef<ISourceControlLabel>> FFriendshipperSourceControlProvider::GetLabels(const FString& InMatchingSpec) const
 {
 	TArray<TSharedRef<ISourceControlLabel>> Tags;
@@ -699,23 +1004,26 @@ ECommandResult::Type FFriendshipperSourceControlProvider::ExecuteSynchronousComm
 		TaskText = FText::GetEmpty();
 	}
 
-	int i = 0;
-
 	// Display the progress dialog if a string was provided
 	{
-		// TODO: support cancellation?
-		// FScopedSourceControlProgress Progress(TaskText, FSimpleDelegate::CreateStatic(&Local::CancelCommand, &InCommand));
-		FScopedSourceControlProgress Progress(TaskText);
+		FScopedSourceControlProgress Progress(TaskText, FSimpleDelegate::CreateStatic(&Local::CancelCommand, &InCommand));
 
 		// Issue the command asynchronously...
+		InCommand.CompletionEvent = FPlatformProcess::GetSynchEventFromPool(true);
 		IssueCommand(InCommand);
 
-		// ... then wait for its completion (thus making it synchronous)
+		// ... then wait for its completion (thus making it synchronous). Workers talk to Friendshipper over HTTP, keep
+		// its requests and server going meanwhile.
+		const uint32 PumpMs = static_cast<uint32>(FMath::Max(CVarSynchronousWaitPumpMs.GetValueOnGameThread(), 1));
 		double LastTime = FPlatformTime::Seconds();
-		while (!InCommand.IsCanceled() && CommandQueue.Contains(&InCommand))
+		double NextProgressTime = LastTime + 0.2;
+		while (!InCommand.IsCanceled() && !InCommand.bCompletionProcessed)
 		{
-			// Tick the command queue and update progress.
-			Tick();
+			// Deliver this command once done, and any other completed one it could be waiting on for its files
+			if (InCommand.CompletionEvent->Wait(PumpMs) || !CompletedCommands.IsEmpty())
+			{
+				Tick();
+			}
 
 			const double AppTime = FPlatformTime::Seconds();
 			const double DeltaTime = AppTime - LastTime;
@@ -723,36 +1031,38 @@ ECommandResult::Type FFriendshipperSourceControlProvider::ExecuteSynchronousComm
 			FHttpServerModule::Get().Tick(DeltaTime);
 			LastTime = AppTime;
 
-			if (i >= 20)
+			if (AppTime >= NextProgressTime)
 			{
 				Progress.Tick();
-				i = 0;
+				NextProgressTime = AppTime + 0.2;
 			}
-			i++;
-
-			// Sleep for a bit so we don't busy-wait so much.
-			FPlatformProcess::Sleep(0.01f);
 		}
 
-		if (InCommand.bCancelled)
+		if (InCommand.IsCanceled())
 		{
 			Result = ECommandResult::Cancelled;
 		}
-		if (InCommand.bCommandSuccessful)
+		else if (InCommand.bCommandSuccessful)
 		{
 			Result = ECommandResult::Succeeded;
 		}
 		else if (InCommand.Conflicts.Num() > 0)
 		{
+			// Check out conflicts are files locked by someone else, reverting the local copy wouldn't help
+			const bool bLockConflicts = InCommand.Operation->GetName() == "CheckOut";
 
-			FText Message(LOCTEXT("Friendshipper_Conflict_Msg", "Operation was cancelled due to conflicts detected in the following files:\n\n"));
+			FText Message = bLockConflicts
+				? LOCTEXT("Friendshipper_LockConflict_Msg", "Check out was cancelled because the following files are locked by someone else:\n\n")
+				: LOCTEXT("Friendshipper_Conflict_Msg", "Operation was cancelled due to conflicts detected in the following files:\n\n");
 
 			for (const FString& File : InCommand.Conflicts)
 			{
 				Message = FText::Format(LOCTEXT("Friendshipper_Conflict_Format", "{0}\n- {1}"), Message, FText::FromString(File));
 			}
 
-			Message = FText::Format(LOCTEXT("Felowshipper_Conflict_Footer", "{0}\n\nConsider reverting the file(s) or discussing with your team on how best to proceed."), Message);
+			Message = bLockConflicts
+				? FText::Format(LOCTEXT("Friendshipper_LockConflict_Footer", "{0}\n\nThe source control log names their lock owners: ask them to release the files, or wait until they are checked in."), Message)
+				: FText::Format(LOCTEXT("Felowshipper_Conflict_Footer", "{0}\n\nConsider reverting the file(s) or discussing with your team on how best to proceed."), Message);
 
 			FMessageDialog::Open(EAppMsgType::Ok, Message);
 		}
@@ -763,8 +1073,13 @@ ECommandResult::Type FFriendshipperSourceControlProvider::ExecuteSynchronousComm
 		}
 	}
 
-	// Delete the command now if not marked as auto-delete
-	if (!InCommand.bAutoDelete)
+	// Delete the command now if not marked as auto-delete. A command cancelled while still running is deleted by Tick
+	// once its thread finishes.
+	if (CommandQueue.Contains(&InCommand))
+	{
+		InCommand.bAutoDelete = true;
+	}
+	else if (!InCommand.bAutoDelete)
 	{
 		delete &InCommand;
 	}
@@ -772,14 +1087,54 @@ ECommandResult::Type FFriendshipperSourceControlProvider::ExecuteSynchronousComm
 	return Result;
 }
 
+FQueuedThreadPool* FFriendshipperSourceControlProvider::GetCommandThreadPool(const EFriendshipperCommandLane InLane)
+{
+	check(IsInGameThread());
+
+	TUniquePtr<FQueuedThreadPool>& Pool = CommandThreadPools[static_cast<int32>(InLane)];
+	if (!Pool.IsValid() && FPlatformProcess::SupportsMultithreading())
+	{
+		const bool bBackground = InLane == EFriendshipperCommandLane::Background;
+		const int32 NumThreads = FMath::Max(1, bBackground ? CVarBackgroundCommandThreads.GetValueOnGameThread() : CVarInteractiveCommandThreads.GetValueOnGameThread());
+
+		Pool.Reset(FQueuedThreadPool::Allocate());
+		if (!Pool->Create(NumThreads, 128 * 1024, bBackground ? TPri_BelowNormal : TPri_Normal, bBackground ? TEXT("FriendshipperBackground") : TEXT("FriendshipperInteractive")))
+		{
+			UE_LOG(LogSourceControl, Error, TEXT("Failed to create the %s command thread pool"), bBackground ? TEXT("background") : TEXT("interactive"));
+			Pool.Reset();
+		}
+	}
+	return Pool.Get();
+}
+
+/** Whole project refreshes and history fetches nobody is blocked on go to the background lane */
+static EFriendshipperCommandLane GetCommandLane(const FFriendshipperSourceControlCommand& InCommand)
+{
+	if (InCommand.bAutoDelete && InCommand.Operation->GetName() == "UpdateStatus")
+	{
+		const FUpdateStatus& UpdateStatus = static_cast<const FUpdateStatus&>(InCommand.Operation.Get());
+		if (InCommand.Files.IsEmpty() || UpdateStatus.ShouldUpdateHistory())
+		{
+			return EFriendshipperCommandLane::Background;
+		}
+	}
+	return EFriendshipperCommandLane::Interactive;
+}
+
+void FFriendshipperSourceControlProvider::StartCommand(FFriendshipperSourceControlCommand& InCommand)
+{
+	GetCommandThreadPool(GetCommandLane(InCommand))->AddQueuedWork(&InCommand);
+}
+
 ECommandResult::Type FFriendshipperSourceControlProvider::IssueCommand(FFriendshipperSourceControlCommand& InCommand)
 {
-	if (GBackgroundPriorityThreadPool != nullptr)
+	if (GetCommandThreadPool(GetCommandLane(InCommand)) != nullptr)
 	{
-		// Queue this to our worker thread(s) for resolving.
+		// Queue this to our worker thread(s) for resolving, once no earlier command works on the same files.
 		// When asynchronous, any callback gets called from Tick().
-		GBackgroundPriorityThreadPool->AddQueuedWork(&InCommand);
+		InCommand.CompletionQueue = &CompletedCommands;
 		CommandQueue.Add(&InCommand);
+		CommandScheduler.Submit(InCommand, [this](FFriendshipperSourceControlCommand& Command) { StartCommand(Command); });
 		return ECommandResult::Succeeded;
 	}
 	else
@@ -789,6 +1144,7 @@ ECommandResult::Type FFriendshipperSourceControlProvider::IssueCommand(FFriendsh
 		InCommand.bCommandSuccessful = InCommand.DoWork();
 
 		InCommand.Worker->UpdateStates();
+		InCommand.bCompletionProcessed = true;
 
 		OutputCommandMessages(InCommand);
 
@@ -875,70 +1231,252 @@ TArray<FString> FFriendshipperSourceControlProvider::GetStatusBranchNames() cons
 	return StatusBranches;
 }
 
-TSet<FString> FFriendshipperSourceControlProvider::GetAllPathsAbsolute()
+FFriendshipperPathSetRef FFriendshipperSourceControlProvider::GetAllPathsAbsolute() const
 {
 	auto Lock = FReadScopeLock(AllPathsAbsoluteLock);
 	return AllPathsAbsolute;
 }
 
-bool FFriendshipperSourceControlProvider::UpdateCachedStates(const TMap<const FString, FFriendshipperState>& InResults)
+TSharedPtr<const FFriendshipperRepoStatusIndex, ESPMode::ThreadSafe> FFriendshipperSourceControlProvider::GetAppliedStatusIndex() const
+{
+	FScopeLock Lock(&AppliedStatusCriticalSection);
+	return AppliedStatusIndex;
+}
+
+bool FFriendshipperSourceControlProvider::UpdateCachedStates(const TMap<FFriendshipperPathId, FFriendshipperState>& InResults)
 {
 	check(IsInGameThread());
 
-	if (InResults.Num() == 0)
+	// These states don't come from the applied status, make sure the next one overwrites them
+	for (const auto& Pair : InResults)
 	{
-		return false;
+		PathsUpdatedSinceAppliedStatus.Add(Pair.Key);
 	}
 
-	for (const auto& Pair : InResults)
+	return ApplyCachedStates(InResults);
+}
+
+/** Combine two partial states, the fields set in InNewer overriding those of InOutOlder */
+static void MergePartialState(FFriendshipperState& InOutOlder, const FFriendshipperState& InNewer)
+{
+	if (InNewer.FileState != EFileState::Unset)
 	{
-		TSharedRef<FFriendshipperSourceControlState, ESPMode::ThreadSafe> State = GetStateInternal(Pair.Key);
+		InOutOlder.FileState = InNewer.FileState;
+	}
+	if (InNewer.TreeState != ETreeState::Unset)
+	{
+		InOutOlder.TreeState = InNewer.TreeState;
+	}
+	if (InNewer.LockState != ELockState::Unset)
+	{
+		InOutOlder.LockState = InNewer.LockState;
+		InOutOlder.LockUserIndex = InNewer.LockUserIndex;
+	}
+	if (InNewer.RemoteState != ERemoteState::Unset)
+	{
+		InOutOlder.RemoteState = InNewer.RemoteState;
+		InOutOlder.HeadBranchIndex = InNewer.HeadBranchIndex;
+	}
+}
 
-		// Force a status update if we've got a new file - this isn't required for all new files but it appears
-		// the source control module handles the update sequencing a bit differently for new files that are the result
-		// of a "duplicate" operation. This appears to fix cases for both new and duplicate files.
-		const bool bForceUpdate = State->State.FileState == EFileState::Unknown && State->State.TreeState == ETreeState::NotInRepo;
+bool FFriendshipperSourceControlProvider::ApplyCachedStates(const TMap<FFriendshipperPathId, FFriendshipperState>& InResults)
+{
+	check(IsInGameThread());
 
-		const FFriendshipperState& NewState = Pair.Value;
-		if (NewState.FileState != EFileState::Unset)
+	const bool bDefer = CVarStateApplyBudgetMs.GetValueOnGameThread() > 0.0f && InResults.Num() > CVarDeferredStatesThreshold.GetValueOnGameThread();
+	if (bDefer)
+	{
+		DeferredStates.Reserve(DeferredStates.Num() + InResults.Num());
+		for (const TPair<FFriendshipperPathId, FFriendshipperState>& Pair : InResults)
 		{
-			// Invalid transition
-			if (NewState.FileState == EFileState::Added && !State->IsUnknown() && !State->CanAdd())
+			if (FFriendshipperState* Deferred = DeferredStates.Find(Pair.Key))
 			{
-				continue;
+				MergePartialState(*Deferred, Pair.Value);
 			}
+			else
+			{
+				DeferredStates.Add(Pair.Key, Pair.Value);
+			}
+		}
+		return false;
+	}
+
+	if (DeferredStates.IsEmpty())
+	{
+		return ApplyCachedStatesNow(InResults);
+	}
+
+	// Fold in the deferred states of these files, an older state must not land after this one
+	TMap<FFriendshipperPathId, FFriendshipperState> Results;
+	Results.Reserve(InResults.Num());
+	for (const TPair<FFriendshipperPathId, FFriendshipperState>& Pair : InResults)
+	{
+		FFriendshipperState State;
+		if (DeferredStates.RemoveAndCopyValue(Pair.Key, State))
+		{
+			MergePartialState(State, Pair.Value);
+			Results.Add(Pair.Key, State);
+		}
+		else
+		{
+			Results.Add(Pair.Key, Pair.Value);
+		}
+	}
+	return ApplyCachedStatesNow(Results);
+}
 
-			State->State.FileState = NewState.FileState;
+bool FFriendshipperSourceControlProvider::ApplyDeferredStates(const double InBudgetSeconds)
+{
+	check(IsInGameThread());
+
+	// Slices are large enough for the state cache to batch its locks, small enough to check the time often
+	constexpr int32 SliceSize = 1024;
+
+	bool bUpdated = false;
+	const double EndTime = FPlatformTime::Seconds() + InBudgetSeconds;
+	TMap<FFriendshipperPathId, FFriendshipperState> Slice;
+	while (DeferredStates.Num() > 0)
+	{
+		Slice.Reset();
+		for (auto It = DeferredStates.CreateIterator(); It && (InBudgetSeconds <= 0.0 || Slice.Num() < SliceSize); ++It)
+		{
+			Slice.Add(It->Key, It->Value);
+			It.RemoveCurrent();
 		}
-		if (NewState.TreeState != ETreeState::Unset)
+		bUpdated |= ApplyCachedStatesNow(Slice);
+
+		if (InBudgetSeconds > 0.0 && FPlatformTime::Seconds() >= EndTime)
 		{
-			State->State.TreeState = NewState.TreeState;
+			break;
 		}
-		// If we're updating lock state, also update user
-		if (NewState.LockState != ELockState::Unset)
+	}
+
+	if (DeferredStates.IsEmpty())
+	{
+		DeferredStates.Empty();
+	}
+	return bUpdated;
+}
+
+void FFriendshipperSourceControlProvider::ApplyDeferredStates(const TArray<FString>& InFiles)
+{
+	if (DeferredStates.IsEmpty())
+	{
+		return;
+	}
+
+	const FFriendshipperPathTable& PathTable = FFriendshipperPathTable::Get();
+	TMap<FFriendshipperPathId, FFriendshipperState> Queried;
+	for (const FString& File : InFiles)
+	{
+		const FFriendshipperPathId Path = PathTable.Find(File);
+		FFriendshipperState State;
+		if (Path.IsValid() && DeferredStates.RemoveAndCopyValue(Path, State))
 		{
-			State->State.LockState = NewState.LockState;
-			State->State.LockUser = NewState.LockUser;
+			Queried.Add(Path, State);
 		}
-		if (NewState.RemoteState != ERemoteState::Unset)
+	}
+	ApplyCachedStatesNow(Queried);
+}
+
+bool FFriendshipperSourceControlProvider::ApplyCachedStatesNow(const TMap<FFriendshipperPathId, FFriendshipperState>& InResults)
+{
+	check(IsInGameThread());
+
+	if (InResults.Num() == 0)
+	{
+		return false;
+	}
+
+	const int32 NumChangedBefore = PendingChangedPaths.Num();
+	const double IgnoreForceUpdateExpiry = FPlatformTime::Seconds() + CVarIgnoreForceUpdateSeconds.GetValueOnGameThread();
+
+	StateCache.Update(InResults, [this, IgnoreForceUpdateExpiry](const FFriendshipperPathId Path, FFriendshipperCachedState& State, const FFriendshipperState& NewState)
 		{
-			State->State.RemoteState = NewState.RemoteState;
-			if (NewState.RemoteState == ERemoteState::UpToDate)
+			const FFriendshipperState OldState = State.State;
+
+			// Force a status update if we've got a new file - this isn't required for all new files but it appears
+			// the source control module handles the update sequencing a bit differently for new files that are the result
+			// of a "duplicate" operation. This appears to fix cases for both new and duplicate files.
+			const bool bForceUpdate = State.State.FileState == EFileState::Unknown && State.State.TreeState == ETreeState::NotInRepo;
+
+			if (NewState.FileState != EFileState::Unset)
 			{
-				State->State.HeadBranch = TEXT("");
+				// Invalid transition
+				if (NewState.FileState == EFileState::Added && !State.State.IsUnknown() && !State.State.CanAdd())
+				{
+					return;
+				}
+
+				State.State.FileState = NewState.FileState;
 			}
-			else
+			if (NewState.TreeState != ETreeState::Unset)
 			{
-				State->State.HeadBranch = NewState.HeadBranch;
+				State.State.TreeState = NewState.TreeState;
 			}
-		}
+			// If we're updating lock state, also update user
+			if (NewState.LockState != ELockState::Unset)
+			{
+				State.State.LockState = NewState.LockState;
+				State.State.LockUserIndex = NewState.LockUserIndex;
+			}
+			if (NewState.RemoteState != ERemoteState::Unset)
+			{
+				State.State.RemoteState = NewState.RemoteState;
+				if (NewState.RemoteState == ERemoteState::UpToDate)
+				{
+					State.State.HeadBranchIndex = 0;
+				}
+				else
+				{
+					State.State.HeadBranchIndex = NewState.HeadBranchIndex;
+				}
+			}
+
+			State.TimeStamp = bForceUpdate ? FDateTime::MinValue() : FDateTime::Now();
+
+			// We've just updated the state, no need for UpdateStatus to be ran for this file again.
+			IgnoreForceCache.Add(Path, IgnoreForceUpdateExpiry);
+
+			if (State.State != OldState)
+			{
+				PendingChangedPaths.Add(Path);
+			}
+		});
+
+	return PendingChangedPaths.Num() != NumChangedBefore;
+}
 
-		State->TimeStamp = bForceUpdate ? FDateTime::MinValue() : FDateTime::Now();
+void FFriendshipperSourceControlProvider::UpdateCachedHistory(const FFriendshipperPathId Path, const TGitSourceControlHistory& History)
+{
+	check(IsInGameThread());
+
+	StateCache.SetHistory(Path, History, FDateTime::Now());
+	MarkStateChanged(Path);
+}
+
+void FFriendshipperSourceControlProvider::MarkStateChanged(const FFriendshipperPathId Path)
+{
+	check(IsInGameThread());
 
-		// We've just updated the state, no need for UpdateStatus to be ran for this file again.
-		AddFileToIgnoreForceCache(State->LocalFilename);
+	PendingChangedPaths.Add(Path);
+}
+
+bool FFriendshipperSourceControlProvider::BroadcastStateChanges()
+{
+	check(IsInGameThread());
+
+	if (PendingChangedPaths.Num() == 0)
+	{
+		return false;
 	}
 
+	FFriendshipperStateChangeSet ChangeSet;
+	ChangeSet.Epoch = ++StateEpoch;
+	ChangeSet.ChangedPaths = PendingChangedPaths.Array();
+	PendingChangedPaths.Reset();
+
+	OnStatesChanged.Broadcast(ChangeSet);
 	return true;
 }
 
@@ -949,60 +1487,305 @@ void FFriendshipperSourceControlProvider::RefreshCacheFromSavedState()
 	FRepoStatus RepoStatus;
 	if (FriendshipperClient.GetStatus(EForceStatusRefresh::False, RepoStatus))
 	{
-		TMap<const FString, FFriendshipperState> States;
+		const TSharedRef<const FFriendshipperRepoStatusIndex, ESPMode::ThreadSafe> StatusIndex = MakeShared<const FFriendshipperRepoStatusIndex, ESPMode::ThreadSafe>(PathToRepositoryRoot, RepoStatus);
+		// Listeners are notified of whatever changed on the next tick
+		ApplyStatusUpdate(ComputeStatusUpdate(StatusIndex));
+	}
+}
+
+FFriendshipperStatusUpdate FFriendshipperSourceControlProvider::ComputeStatusUpdate(const TSharedRef<const FFriendshipperRepoStatusIndex, ESPMode::ThreadSafe>& InStatusIndex)
+{
+	FFriendshipperStatusUpdate Update;
+	Update.StatusIndex = InStatusIndex;
+	Update.LockUser = LockUser;
+	Update.Attributes = FriendshipperSourceControlUtils::GetGitAttributes();
+
+	const FFriendshipperPathSetRef Paths = GetAllPathsAbsolute();
+	Update.Paths = Paths;
+
+	TSharedPtr<const TSet<FFriendshipperPathId>, ESPMode::ThreadSafe> BasePaths;
+	TSharedPtr<const FFriendshipperGitAttributes, ESPMode::ThreadSafe> BaseAttributes;
+	FString BaseLockUser;
+	{
+		FScopeLock Lock(&AppliedStatusCriticalSection);
+		Update.BaseStatusIndex = AppliedStatusIndex;
+		BasePaths = AppliedPaths;
+		BaseAttributes = AppliedAttributes;
+		BaseLockUser = AppliedLockUser;
+	}
+
+	// A different set of tracked files, lockable attributes or lock user can change the state of any file
+	if (!Update.BaseStatusIndex.IsValid() || BasePaths != Update.Paths || BaseAttributes != Update.Attributes || BaseLockUser != Update.LockUser)
+	{
+		Update.BaseStatusIndex.Reset();
+		Update.States = FriendshipperSourceControlUtils::FriendshipperStatesFromStatusIndex(*Paths, &Paths.Get(), *InStatusIndex);
+		return Update;
+	}
+
+	TSet<FFriendshipperPathId> ChangedPaths;
+	InStatusIndex->CollectChangedPaths(*Update.BaseStatusIndex, ChangedPaths);
+	for (auto It = ChangedPaths.CreateIterator(); It; ++It)
+	{
+		if (!Paths->Contains(*It))
 		{
-			auto Lock = FReadScopeLock(AllPathsAbsoluteLock);
-			States = FriendshipperSourceControlUtils::FriendshipperStatesFromRepoStatus(PathToRepositoryRoot, AllPathsAbsolute, RepoStatus);
+			It.RemoveCurrent();
 		}
-		UpdateCachedStates(States);
+	}
+	Update.States = FriendshipperSourceControlUtils::FriendshipperStatesFromStatusIndex(ChangedPaths, &Paths.Get(), *InStatusIndex);
+
+	return Update;
+}
+
+bool FFriendshipperSourceControlProvider::ApplyStatusUpdate(const FFriendshipperStatusUpdate& InUpdate)
+{
+	check(IsInGameThread());
+
+	if (!InUpdate.StatusIndex.IsValid())
+	{
+		return false;
+	}
+
+	TSharedPtr<const FFriendshipperRepoStatusIndex, ESPMode::ThreadSafe> CurrentStatusIndex;
+	{
+		FScopeLock Lock(&AppliedStatusCriticalSection);
+		CurrentStatusIndex = AppliedStatusIndex;
+	}
 
-		// Trigger a callback to anyone listening for state updates next tick
-		if (TicksUntilNextForcedUpdate <= 0)
+	const FFriendshipperPathSetRef Paths = GetAllPathsAbsolute();
+	const TSharedPtr<const FFriendshipperGitAttributes, ESPMode::ThreadSafe> Attributes = FriendshipperSourceControlUtils::GetGitAttributes();
+
+	bool bUpdated = false;
+	if (InUpdate.Paths.Get() != &Paths.Get() || InUpdate.Attributes != Attributes || InUpdate.LockUser != LockUser || (InUpdate.BaseStatusIndex.IsValid() && !CurrentStatusIndex.IsValid()))
+	{
+		// What the update was computed against is gone, start over from every tracked file
+		bUpdated = ApplyCachedStates(FriendshipperSourceControlUtils::FriendshipperStatesFromStatusIndex(*Paths, &Paths.Get(), *InUpdate.StatusIndex));
+	}
+	else
+	{
+		bUpdated = ApplyCachedStates(InUpdate.States);
+
+		// Catch up with statuses applied after this one was computed, and with files updated by operations since
+		TSet<FFriendshipperPathId> StalePaths = MoveTemp(PathsUpdatedSinceAppliedStatus);
+		if (CurrentStatusIndex.IsValid() && CurrentStatusIndex != InUpdate.BaseStatusIndex)
+		{
+			InUpdate.StatusIndex->CollectChangedPaths(*CurrentStatusIndex, StalePaths);
+		}
+		for (auto It = StalePaths.CreateIterator(); It; ++It)
+		{
+			if (InUpdate.States.Contains(*It) || !Paths->Contains(*It))
+			{
+				It.RemoveCurrent();
+			}
+		}
+		if (StalePaths.Num() > 0)
+		{
+			bUpdated |= ApplyCachedStates(FriendshipperSourceControlUtils::FriendshipperStatesFromStatusIndex(StalePaths, &Paths.Get(), *InUpdate.StatusIndex));
+		}
+	}
+	PathsUpdatedSinceAppliedStatus.Reset();
+	bUpdated |= DropUntrackedSavedStates(*Paths);
+
+	{
+		FScopeLock Lock(&AppliedStatusCriticalSection);
+		AppliedStatusIndex = InUpdate.StatusIndex;
+		AppliedPaths = Paths;
+		AppliedAttributes = Attributes;
+		AppliedLockUser = LockUser;
+	}
+
+	return bUpdated;
+}
+
+bool FFriendshipperSourceControlProvider::DropUntrackedSavedStates(const TSet<FFriendshipperPathId>& InPaths)
+{
+	if (SavedStatePaths.IsEmpty())
+	{
+		return false;
+	}
+
+	// Whether the listing is the saved one or a rescanned one, files it leaves out have no state worth keeping
+	TArray<FFriendshipperPathId> UntrackedPaths;
+	for (const FFriendshipperPathId Path : SavedStatePaths)
+	{
+		if (!InPaths.Contains(Path))
 		{
-			TicksUntilNextForcedUpdate = 1;
+			UntrackedPaths.Add(Path);
 		}
 	}
+
+	// Until a rescan replaces the saved listing, files deleted since the last session can't be told apart
+	const bool bRescanned = SavedPaths.Get() != &InPaths;
+	if (bRescanned)
+	{
+		SavedStatePaths.Empty();
+		SavedPaths.Reset();
+	}
+	else
+	{
+		for (const FFriendshipperPathId Path : UntrackedPaths)
+		{
+			SavedStatePaths.Remove(Path);
+		}
+	}
+
+	for (const FFriendshipperPathId Path : UntrackedPaths)
+	{
+		DeferredStates.Remove(Path);
+		if (StateCache.Remove(Path))
+		{
+			PendingChangedPaths.Add(Path);
+		}
+	}
+	if (UntrackedPaths.Num() > 0)
+	{
+		UE_LOG(LogSourceControl, Log, TEXT("Dropped %d saved states of files that aren't tracked anymore"), UntrackedPaths.Num());
+	}
+	return UntrackedPaths.Num() > 0;
+}
+
+bool FFriendshipperSourceControlProvider::LoadSavedStates()
+{
+	if (!CVarPersistentStateCache.GetValueOnGameThread() || StateCache.Num() > 0)
+	{
+		return false;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	const FString Filename = FriendshipperStateCacheFile::GetDefaultPath();
+	FFriendshipperSavedStates Saved;
+	if (!FriendshipperStateCacheFile::Load(Filename, Saved) || Saved.RepositoryRoot != PathToRepositoryRoot)
+	{
+		return false;
+	}
+
+	{
+		FWriteScopeLock Lock(AllPathsAbsoluteLock);
+		AllPathsAbsolute = MakeShared<const TSet<FFriendshipperPathId>, ESPMode::ThreadSafe>(MoveTemp(Saved.Paths));
+		SavedPaths = AllPathsAbsolute;
+	}
+
+	// Not through ApplyCachedStates: these must not hold off the forced updates that will correct them
+	const FDateTime Now = FDateTime::Now();
+	StateCache.Update(Saved.States, [Now](FFriendshipperPathId, FFriendshipperCachedState& State, const FFriendshipperState& NewState)
+		{
+			State.State = NewState;
+			State.TimeStamp = Now;
+		});
+	for (const TPair<FFriendshipperPathId, FFriendshipperState>& Pair : Saved.States)
+	{
+		PendingChangedPaths.Add(Pair.Key);
+		SavedStatePaths.Add(Pair.Key);
+	}
+
+	UE_LOG(LogSourceControl, Log, TEXT("Loaded %d saved states of status %s (%s) from '%s' in %.3fs"),
+		Saved.States.Num(), *Saved.LastUpdated, *Saved.CommitHeadOrigin, *Filename, FPlatformTime::Seconds() - StartTime);
+	return true;
+}
+
+void FFriendshipperSourceControlProvider::SaveStates() const
+{
+	TSharedPtr<const FFriendshipperRepoStatusIndex, ESPMode::ThreadSafe> StatusIndex;
+	{
+		FScopeLock Lock(&AppliedStatusCriticalSection);
+		StatusIndex = AppliedStatusIndex;
+	}
+
+	// Provisional states never got reconciled with a status, keep the file they came from
+	if (!CVarPersistentStateCache.GetValueOnGameThread() || !StatusIndex.IsValid())
+	{
+		return;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+	FFriendshipperSavedStates Saved;
+	Saved.RepositoryRoot = PathToRepositoryRoot;
+	Saved.LastUpdated = StatusIndex->GetLastUpdated();
+	Saved.CommitHeadOrigin = StatusIndex->GetCommitHeadOrigin();
+	Saved.Paths = GetAllPathsAbsolute().Get();
+	Saved.States.Reserve(StateCache.Num());
+	StateCache.ForEach([&Saved](const FFriendshipperPathId Path, const FFriendshipperCachedState& State)
+		{
+			Saved.States.Add(Path, State.State);
+		});
+
+	const FString Filename = FriendshipperStateCacheFile::GetDefaultPath();
+	if (FriendshipperStateCacheFile::Save(Filename, Saved))
+	{
+		UE_LOG(LogSourceControl, Log, TEXT("Saved %d states to '%s' in %.3fs"), Saved.States.Num(), *Filename, FPlatformTime::Seconds() - StartTime);
+	}
 }
 
 void FFriendshipperSourceControlProvider::RunFileRescanTask()
 {
+	// Only one scan at a time, changes happening during a scan are picked up by another one when it completes
+	if (bAllPathsScanInProgress.exchange(true))
+	{
+		bAllPathsRescanPending = true;
+		return;
+	}
+
 	const FString GitBinaryPath = PathToGitBinary;
 	const FString RepoRoot = PathToRepositoryRoot;
 
 	auto RescanTaskFunc = [GitBinaryPath, RepoRoot]()
 		{
+			// The root attributes files aren't watched, catch up with any edit to them here
+			const TSharedPtr<const FFriendshipperGitAttributes, ESPMode::ThreadSafe> Attributes = FriendshipperSourceControlUtils::GetGitAttributes();
+			if (Attributes.IsValid() && !Attributes->IsUpToDate())
+			{
+				FriendshipperSourceControlUtils::LoadGitAttributes(GitBinaryPath, RepoRoot);
+			}
+
 			const TArray<FString> ProjectDirs
 			{
 				FPaths::ConvertRelativePathToFull(FPaths::ProjectContentDir()),
 				FPaths::ConvertRelativePathToFull(FPaths::ProjectConfigDir()),
 			};
 
-			TUniquePtr<TSet<FString>> AllFiles = MakeUnique<TSet<FString>>();
+			FFriendshipperPathTable& PathTable = FFriendshipperPathTable::Get();
+			TSet<FFriendshipperPathId> AllFiles;
 			for (const FString& DirPath : ProjectDirs)
 			{
 				TArray<FString> Files;
 				FriendshipperSourceControlUtils::ListFilesInDirectoryRecurse(GitBinaryPath, RepoRoot, DirPath, Files);
-				AllFiles->Append(MoveTemp(Files));
+				AllFiles.Reserve(AllFiles.Num() + Files.Num());
+				for (const FString& File : Files)
+				{
+					AllFiles.Add(PathTable.Intern(File));
+				}
 			}
 
-			if (AllFiles->Num() > 0)
+			// An empty listing means git failed, keep the previous one
+			TSharedPtr<const TSet<FFriendshipperPathId>, ESPMode::ThreadSafe> Snapshot;
+			if (AllFiles.Num() > 0)
 			{
-				AsyncTask(ENamedThreads::GameThread, [Files = std::move(AllFiles)]()
+				Snapshot = MakeShared<const TSet<FFriendshipperPathId>, ESPMode::ThreadSafe>(MoveTemp(AllFiles));
+			}
+
+			AsyncTask(ENamedThreads::GameThread, [Snapshot = MoveTemp(Snapshot)]()
+				{
+					if (FFriendshipperSourceControlModule* SCC = FFriendshipperSourceControlModule::GetThreadSafe())
 					{
-						if (FFriendshipperSourceControlModule* SCC = FFriendshipperSourceControlModule::GetThreadSafe())
+						FFriendshipperSourceControlProvider& Provider = SCC->GetProvider();
+
+						if (Snapshot.IsValid())
 						{
-							FFriendshipperSourceControlProvider& Provider = SCC->GetProvider();
+							auto Lock = FWriteScopeLock(Provider.AllPathsAbsoluteLock);
+							Provider.AllPathsAbsolute = Snapshot.ToSharedRef();
+						}
 
-							{
-								auto Lock = FWriteScopeLock(Provider.AllPathsAbsoluteLock);
-								Provider.AllPathsAbsolute = MoveTemp(*Files);
-							}
+						Provider.bAllPathsScanInProgress = false;
+						if (Provider.bAllPathsRescanPending.exchange(false))
+						{
+							Provider.RunFileRescanTask();
+						}
 
-							Provider.bAllPathsScanInProgress = false;
+						if (Snapshot.IsValid())
+						{
 							Provider.RefreshCacheFromSavedState();
 						}
-					});
-			}
+					}
+				});
 		};
 
 	if (IsInGameThread())
@@ -1023,9 +1806,13 @@ void FFriendshipperSourceControlProvider::RunFileRescanTask()
 
 void FFriendshipperSourceControlProvider::OnFilesChanged(const TArray<struct FFileChangeData>& FileChanges)
 {
-	if (bAllPathsScanInProgress)
+	for (const FFileChangeData& Change : FileChanges)
 	{
-		return;
+		if (FFriendshipperGitAttributes::IsAttributesFile(Change.Filename))
+		{
+			ReloadGitAttributes();
+			break;
+		}
 	}
 
 	bool bNeedsRescan = false;
@@ -1045,6 +1832,27 @@ void FFriendshipperSourceControlProvider::OnFilesChanged(const TArray<struct FFi
 	}
 }
 
+void FFriendshipperSourceControlProvider::ReloadGitAttributes()
+{
+	const FString GitBinaryPath = PathToGitBinary;
+	const FString RepoRoot = PathToRepositoryRoot;
+	AsyncTask(ENamedThreads::AnyBackgroundThreadNormalTask, [GitBinaryPath, RepoRoot]()
+		{
+			FriendshipperSourceControlUtils::LoadGitAttributes(GitBinaryPath, RepoRoot);
+
+			AsyncTask(ENamedThreads::GameThread, []()
+				{
+					if (FFriendshipperSourceControlModule* SCC = FFriendshipperSourceControlModule::GetThreadSafe())
+					{
+						FFriendshipperSourceControlProvider& Provider = SCC->GetProvider();
+
+						// Lockability is part of every file state, the new attributes make the refresh recompute them all
+						Provider.RefreshCacheFromSavedState();
+					}
+				});
+		});
+}
+
 void FFriendshipperSourceControlProvider::OnRecievedHttpStatusUpdate(const FRepoStatus& RepoStatus)
 {
 	FriendshipperClient.OnRecievedHttpStatusUpdate(RepoStatus);
@@ -5,15 +5,22 @@
 
 #pragma once
 
+#include "Containers/Queue.h"
 #include "FriendshipperClient.h"
+#include "FriendshipperCommandScheduler.h"
+#include "FriendshipperPathTable.h"
+#include "FriendshipperStateCache.h"
 #include "ISourceControlProvider.h"
 #include "IFriendshipperSourceControlWorker.h"
 #include "FriendshipperSourceControlMenu.h"
+#include "Misc/QueuedThreadPool.h"
 #include "Runtime/Launch/Resources/Version.h"
 
 class FFriendshipperSourceControlState;
 class FFriendshipperSourceControlCommand;
+class FFriendshipperRepoStatusIndex;
 struct FFriendshipperState;
+struct FFriendshipperStatusUpdate;
 
 DECLARE_DELEGATE_RetVal(FFriendshipperSourceControlWorkerRef, FGetFriendshipperSourceControlWorker)
 
@@ -42,6 +49,42 @@ DECLARE_DELEGATE_RetVal(FFriendshipperSourceControlWorkerRef, FGetFriendshipperS
 	}
 };
 
+/** Files whose state changed since the last notification */
+struct FFriendshipperStateChangeSet
+{
+	/** Value of the provider's state epoch once these changes were applied */
+	uint64 Epoch = 0;
+
+	/** Interned absolute paths of the changed files, see FFriendshipperPathTable */
+	TArray<FFriendshipperPathId> ChangedPaths;
+};
+
+DECLARE_MULTICAST_DELEGATE_OneParam(FFriendshipperStatesChanged, const FFriendshipperStateChangeSet& /*ChangeSet*/);
+
+/** Thread pools commands run on, so that background refreshes never hold up operations the user is waiting on */
+enum class EFriendshipperCommandLane : uint8
+{
+	/** Operations on files, and anything run synchronously */
+	Interactive,
+	/** Refreshes of the whole project, and history fetches */
+	Background,
+
+	Num
+};
+
+/** Asynchronous UpdateStatus requests waiting to be merged into a single command, see Friendshipper.CoalesceUpdateStatusSeconds */
+struct FFriendshipperCoalescedUpdateStatus
+{
+	/** Union of the files of every request */
+	TSet<FString> Files;
+
+	/** The operations merged so far, with their completion delegates */
+	TArray<TPair<FSourceControlOperationRef, FSourceControlOperationComplete>> Requests;
+
+	/** When to issue the merged command */
+	double IssueTime = 0.0;
+};
+
 struct FFriendshipperFileWatchHandle
 {
 	FString Directory;
@@ -128,6 +171,9 @@ public:
 		return PathToRepositoryRoot;
 	}
 
+	/** Thread pool running the commands of a lane, created on first use. Null if the platform can't run threads. */
+	FQueuedThreadPool* GetCommandThreadPool(EFriendshipperCommandLane InLane);
+
 	/** Path to the root of the Git repository: can be the ProjectDir itself, or any parent directory (found by the "Connect" operation) */
 	const FString& GetPathToGitRoot() const
 	{
@@ -168,8 +214,44 @@ public:
 		return FriendshipperClient;
 	}
 
+	/**
+	 * GetState, choosing how a ForceUpdate refreshes the files: synchronously before returning, or asynchronously,
+	 * returning the cached states right away and notifying through OnStatesChanged once the coalesced refresh is applied.
+	 * The ISourceControlProvider override uses Friendshipper.AsyncForceUpdate.
+	 */
+	ECommandResult::Type GetState(const TArray<FString>& InFiles, TArray<FSourceControlStateRef>& OutState, EStateCacheUsage::Type InStateCacheUsage, EConcurrency::Type InForceUpdateConcurrency);
+
 	/** Helper function used to update state cache */
 	TSharedRef<FFriendshipperSourceControlState, ESPMode::ThreadSafe> GetStateInternal(const FString& Filename);
+	TSharedRef<FFriendshipperSourceControlState, ESPMode::ThreadSafe> GetStateInternal(FFriendshipperPathId Path);
+
+	/**
+	 * GetCachedStateByPredicate restricted to files with pending work (modified, added, deleted, locked, not at head...),
+	 * which only goes through the state cache index. Predicates accepting clean files miss them.
+	 */
+	TArray<FSourceControlStateRef> GetPendingStateByPredicate(TFunctionRef<bool(const FSourceControlStateRef&)> Predicate) const;
+
+	/** Copy the cached state of a file, false if it isn't cached. Unlike GetState, safe to call from worker threads. */
+	bool GetCachedState(const FString& Filename, FFriendshipperState& OutState) const;
+
+	/**
+	 * Register to be notified of the files whose state changed, once per tick with changes, right before the generic
+	 * state changed delegate. Not called at all when an update doesn't change any state.
+	 */
+	FDelegateHandle RegisterStatesChanged_Handle(const FFriendshipperStatesChanged::FDelegate& StatesChanged);
+	void UnregisterStatesChanged_Handle(FDelegateHandle Handle);
+
+	/** Incremented every time a change set is broadcast, so listeners can tell whether they are up to date. Safe to read from any thread. */
+	uint64 GetStateEpoch() const
+	{
+		return StateEpoch;
+	}
+
+	/** Include a file in the next change set, for changes made to a state object outside of UpdateCachedStates */
+	void MarkStateChanged(FFriendshipperPathId Path);
+
+	/** Set the history of a file, shown by its state object */
+	void UpdateCachedHistory(FFriendshipperPathId Path, const TGitSourceControlHistory& History);
 
 	/**
 	 * Register a worker with the provider.
@@ -206,11 +288,27 @@ public:
 	TArray<FString> GetStatusBranchNames() const;
 
 	// Source control state cache refresh
-	TSet<FString> GetAllPathsAbsolute();
-	bool UpdateCachedStates(const TMap<const FString, FFriendshipperState>& InResults);
+	FFriendshipperPathSetRef GetAllPathsAbsolute() const;
+	bool UpdateCachedStates(const TMap<FFriendshipperPathId, FFriendshipperState>& InResults);
 	void RefreshCacheFromSavedState();
+
+	/**
+	 * Compute the states to apply for a new status. Only the files whose status entries changed since the last applied
+	 * status are computed, unless the tracked files or the lock user changed in between. Can be called from any thread.
+	 */
+	FFriendshipperStatusUpdate ComputeStatusUpdate(const TSharedRef<const FFriendshipperRepoStatusIndex, ESPMode::ThreadSafe>& InStatusIndex);
+
+	/** Apply states computed by ComputeStatusUpdate, catching up with anything applied since they were computed */
+	bool ApplyStatusUpdate(const FFriendshipperStatusUpdate& InUpdate);
+
+	/** Index of the status the cache was last refreshed from, null until one is applied. Can be called from any thread. */
+	TSharedPtr<const FFriendshipperRepoStatusIndex, ESPMode::ThreadSafe> GetAppliedStatusIndex() const;
+
 	void RunFileRescanTask();
 	void OnFilesChanged(const TArray<struct FFileChangeData>& FileChanges);
+
+	/** Reparse the .gitattributes files in the background, then refresh every state with the new lockable files */
+	void ReloadGitAttributes();
 	void OnRecievedHttpStatusUpdate(const FRepoStatus& RepoStatus);
 
 	uint32 TicksUntilNextForcedUpdate = 0;
@@ -241,9 +339,36 @@ private:
 	/** Issue a command asynchronously if possible. */
 	ECommandResult::Type IssueCommand(class FFriendshipperSourceControlCommand& InCommand);
 
+	/**
+	 * Merge an asynchronous UpdateStatus into the pending one of its kind (files or whole project), to be issued as a
+	 * single command once the coalescing window elapses. Returns false if the operation must run on its own.
+	 */
+	bool CoalesceUpdateStatus(const FSourceControlOperationRef& InOperation, const TArray<FString>& InFiles, const FSourceControlOperationComplete& InOperationCompleteDelegate);
+
+	/** Issue the merged UpdateStatus command of a batch, completing every request merged into it */
+	void IssueCoalescedUpdateStatus(FFriendshipperCoalescedUpdateStatus& InOutBatch);
+
+	/**
+	 * Merge new states into the state cache, queuing the files whose state changed. Returns true if any did.
+	 * Large results are deferred instead, and applied over the next ticks by ApplyDeferredStates.
+	 */
+	bool ApplyCachedStates(const TMap<FFriendshipperPathId, FFriendshipperState>& InResults);
+
+	/** Merge new states into the state cache right away */
+	bool ApplyCachedStatesNow(const TMap<FFriendshipperPathId, FFriendshipperState>& InResults);
+
+	/** Apply deferred states for at most InBudgetSeconds (everything if <= 0). Returns true if any state changed. */
+	bool ApplyDeferredStates(double InBudgetSeconds);
+
+	/** Apply the deferred states of the given files, so that they are up to date when queried */
+	void ApplyDeferredStates(const TArray<FString>& InFiles);
+
 	/** Output any messages this command holds */
 	void OutputCommandMessages(const class FFriendshipperSourceControlCommand& InCommand) const;
 
+	/** Update the states, output the messages and return the results of a completed command. Returns true if any state changed. */
+	bool ProcessCompletedCommand(class FFriendshipperSourceControlCommand& InCommand);
+
 	/** Update repository status on Connect and UpdateStatus operations */
 	void UpdateRepositoryStatus(const class FFriendshipperSourceControlCommand& InCommand);
 
@@ -275,14 +400,37 @@ private:
 	FString CommitSummary;
 
 	/** State cache */
-	TMap<FString, TSharedRef<class FFriendshipperSourceControlState, ESPMode::ThreadSafe>> StateCache;
+	FFriendshipperStateCache StateCache;
 
-	/** All source controlled files in the repo under Content/ and Config/ */
-	FRWLock AllPathsAbsoluteLock;
-	TSet<FString> AllPathsAbsolute;
+	/** All source controlled files in the repo under Content/ and Config/, replaced as a whole by each rescan */
+	mutable FRWLock AllPathsAbsoluteLock;
+	FFriendshipperPathSetRef AllPathsAbsolute = MakeShared<const TSet<FFriendshipperPathId>, ESPMode::ThreadSafe>();
+
+	/** Status the cache was last refreshed from, so that the next refresh only recomputes what changed */
+	mutable FCriticalSection AppliedStatusCriticalSection;
+	TSharedPtr<const FFriendshipperRepoStatusIndex, ESPMode::ThreadSafe> AppliedStatusIndex;
+	TSharedPtr<const TSet<FFriendshipperPathId>, ESPMode::ThreadSafe> AppliedPaths;
+	TSharedPtr<const class FFriendshipperGitAttributes, ESPMode::ThreadSafe> AppliedAttributes;
+	FString AppliedLockUser;
+
+	/**
+	 * Files given a state by LoadSavedStates, and the tracked files they were loaded with. Once a status is applied to
+	 * the tracked files of a real scan, the ones left out aren't tracked anymore and their saved states are dropped.
+	 */
+	TSet<FFriendshipperPathId> SavedStatePaths;
+	TSharedPtr<const TSet<FFriendshipperPathId>, ESPMode::ThreadSafe> SavedPaths;
+
+	/** States of results too large to apply in a single tick, waiting for ApplyDeferredStates */
+	TMap<FFriendshipperPathId, FFriendshipperState> DeferredStates;
+
+	/** Files updated by operations since the last applied status, recomputed along with the next one */
+	TSet<FFriendshipperPathId> PathsUpdatedSinceAppliedStatus;
 
 	/** Flag to skip triggering another scan if one is in progress */
-	std::atomic<bool> bAllPathsScanInProgress;
+	std::atomic<bool> bAllPathsScanInProgress{ false };
+
+	/** Files were added or removed during the scan in progress, scan again once it completes */
+	std::atomic<bool> bAllPathsRescanPending{ false };
 
 	/** Delegates to unregister on shutdown */
 	TArray<FFriendshipperFileWatchHandle> FileWatchHandles;
@@ -290,12 +438,42 @@ private:
 	/** The currently registered revision control operations */
 	TMap<FName, FGetFriendshipperSourceControlWorker> WorkersMap;
 
-	/** Queue for commands given by the main thread */
+	/** UpdateStatus requests on given files, and on the whole project */
+	FFriendshipperCoalescedUpdateStatus CoalescedFilesStatus;
+	FFriendshipperCoalescedUpdateStatus CoalescedProjectStatus;
+
+	/** Requests merged into UpdateStatus commands still in flight, so that they can be cancelled one by one */
+	TMap<FFriendshipperSourceControlCommand*, TSharedRef<TArray<TPair<FSourceControlOperationRef, FSourceControlOperationComplete>>>> CoalescedStatusInFlight;
+
+	/** Commands given by the main thread that are still in flight */
 	TArray<FFriendshipperSourceControlCommand*> CommandQueue;
 
+	/** Orders the commands of CommandQueue working on the same files */
+	FFriendshipperCommandScheduler CommandScheduler;
+
+	/** Queue a command started by CommandScheduler on the thread pool of its lane */
+	void StartCommand(class FFriendshipperSourceControlCommand& InCommand);
+
+	/** Commands processed by a worker thread, pushed by that thread and delivered by Tick */
+	TQueue<FFriendshipperSourceControlCommand*, EQueueMode::Mpsc> CompletedCommands;
+
+	/** See GetCommandThreadPool. Declared after CompletedCommands so that the pools are destroyed first: they push the commands they abandon to it. */
+	TUniquePtr<FQueuedThreadPool> CommandThreadPools[static_cast<int32>(EFriendshipperCommandLane::Num)];
+
 	/** For notifying when the revision control states in the cache have changed */
 	FSourceControlStateChanged OnSourceControlStateChanged;
 
+	/** For notifying which files changed, see RegisterStatesChanged_Handle */
+	FFriendshipperStatesChanged OnStatesChanged;
+
+	/** Files whose state changed since the last broadcast, only touched on the game thread */
+	TSet<FFriendshipperPathId> PendingChangedPaths;
+
+	std::atomic<uint64> StateEpoch{ 0 };
+
+	/** Broadcast the pending change set, if any. Returns true if there was one. */
+	bool BroadcastStateChanges();
+
 	/** Git version for feature checking */
 	FFriendshipperVersion GitVersion;
 
@@ -307,8 +485,33 @@ private:
 	/**
 		Ignore these files when forcing status updates. We add to this list when we've just updated the status already.
 		UE's SourceControl has a habit of performing a double status update, immediately after an operation.
+		Entries map to the time they expire at, see Friendshipper.IgnoreForceUpdateSeconds.
 	*/
-	TArray<FString> IgnoreForceCache;
+	TMap<FFriendshipperPathId, double> IgnoreForceCache;
+
+	/** Time of the next removal of expired IgnoreForceCache entries */
+	double NextIgnoreForceCachePrune = 0.0;
+
+	/** Remove expired IgnoreForceCache entries, at most once per expiry interval */
+	void PruneIgnoreForceCache();
+
+	/**
+	 * Seed the cache with the states saved by the previous session, see Friendshipper.PersistentStateCache. They are
+	 * only provisional: the first status received is applied to every tracked file, which reconciles them.
+	 */
+	bool LoadSavedStates();
+
+	/** Shared by GetCachedStateByPredicate and GetPendingStateByPredicate: filter every cached state, or only the indexed ones */
+	TArray<FSourceControlStateRef> FilterCachedStates(TFunctionRef<bool(const FSourceControlStateRef&)> Predicate, bool bInPendingOnly) const;
+
+	/**
+	 * Remove the saved states of files left out of the tracked files a status was just applied to. Once these come
+	 * from a rescan rather than from the saved listing, every saved state has been reconciled and none is kept track of.
+	 */
+	bool DropUntrackedSavedStates(const TSet<FFriendshipperPathId>& InPaths);
+
+	/** Save the tracked files and the states of the last applied status for the next session */
+	void SaveStates() const;
 
 	/** Array of branch name patterns for status queries */
 	TArray<FString> StatusBranchNamePatternsInternal;
@@ -5,6 +5,8 @@
 
 #include "FriendshipperSourceControlState.h"
 
+#include "ISourceControlModule.h"
+#include "Misc/ScopeRWLock.h"
 #include "Textures/SlateIcon.h"
 #if ENGINE_MINOR_VERSION >= 2
 #include "RevisionControlStyle/RevisionControlStyle.h"
@@ -12,6 +14,171 @@
 
 #define LOCTEXT_NAMESPACE "GitSourceControl.State"
 
+FFriendshipperNameTable::FFriendshipperNameTable()
+{
+	Names.Add(MakeUnique<FString>());
+	Indices.Add(FString(), 0);
+}
+
+FFriendshipperNameTable& FFriendshipperNameTable::LockUsers()
+{
+	static FFriendshipperNameTable Table;
+	return Table;
+}
+
+FFriendshipperNameTable& FFriendshipperNameTable::Branches()
+{
+	static FFriendshipperNameTable Table;
+	return Table;
+}
+
+uint16 FFriendshipperNameTable::Intern(const FString& InName)
+{
+	{
+		FReadScopeLock ReadLock(Lock);
+		if (const uint16* Index = Indices.Find(InName))
+		{
+			return *Index;
+		}
+	}
+
+	FWriteScopeLock WriteLock(Lock);
+	if (const uint16* Index = Indices.Find(InName))
+	{
+		return *Index;
+	}
+	if (Names.Num() > MAX_uint16)
+	{
+		UE_LOG(LogSourceControl, Warning, TEXT("Too many distinct names to intern, dropping '%s'"), *InName);
+		return 0;
+	}
+
+	const uint16 Index = static_cast<uint16>(Names.Num());
+	Names.Add(MakeUnique<FString>(InName));
+	Indices.Add(InName, Index);
+	return Index;
+}
+
+const FString& FFriendshipperNameTable::Get(const uint16 InIndex) const
+{
+	FReadScopeLock ReadLock(Lock);
+	return Names.IsValidIndex(InIndex) ? *Names[InIndex] : *Names[0];
+}
+
+bool FFriendshipperState::CanCheckout() const
+{
+	// Packages that don't exist on disk can't be checked out
+	if (TreeState == ETreeState::NotInRepo)
+	{
+		return false;
+	}
+
+	// untracked files go through the "mark for add" workflow
+	if (TreeState == ETreeState::Untracked)
+	{
+		return false;
+	}
+
+	if (LockState == ELockState::Unlockable)
+	{
+		// Everything is already available for check in (checked out).
+		return false;
+	}
+
+	// We don't want to allow checkout if the file is out-of-date, as modifying an out-of-date binary file will most likely result in a merge conflict
+	return LockState == ELockState::NotLocked && IsCurrent();
+}
+
+bool FFriendshipperState::IsCurrent() const
+{
+	return RemoteState != ERemoteState::NotAtHead && RemoteState != ERemoteState::NotLatest;
+}
+
+bool FFriendshipperState::IsSourceControlled() const
+{
+	return TreeState != ETreeState::Untracked && TreeState != ETreeState::Ignored && TreeState != ETreeState::NotInRepo;
+}
+
+bool FFriendshipperState::IsAdded() const
+{
+	// We don't stage files in this plugin on purpose, but treat untracked + locked files as added
+	return (TreeState == ETreeState::Staged) ||
+		(TreeState == ETreeState::Untracked && LockState == ELockState::Locked);
+}
+
+bool FFriendshipperState::IsUnknown() const
+{
+	return FileState == EFileState::Unknown && TreeState == ETreeState::NotInRepo;
+}
+
+bool FFriendshipperState::CanAdd() const
+{
+	return TreeState == ETreeState::Untracked;
+}
+
+EGitState::Type FFriendshipperState::GetGitState() const
+{
+	// No matter what, we must pull from remote, even if we have locked or if we have modified.
+	switch (RemoteState)
+	{
+	case ERemoteState::NotAtHead:
+		return EGitState::NotAtHead;
+	default:
+		break;
+	}
+
+	/** Someone else locked this file across branches. */
+	// We cannot push under any circumstance, if someone else has locked.
+	if (LockState == ELockState::LockedOther)
+	{
+		return EGitState::LockedOther;
+	}
+
+	// We could theoretically push, but we shouldn't.
+	if (RemoteState == ERemoteState::NotLatest)
+	{
+		return EGitState::NotLatest;
+	}
+
+	if (IsAdded())
+	{
+		return EGitState::Added;
+	}
+
+	switch (FileState)
+	{
+	case EFileState::Unmerged:
+		return EGitState::Unmerged;
+	case EFileState::Deleted:
+		return EGitState::Deleted;
+	case EFileState::Modified:
+		return EGitState::Modified;
+	default:
+		break;
+	}
+
+	if (TreeState == ETreeState::Untracked)
+	{
+		return EGitState::Untracked;
+	}
+
+	if (LockState == ELockState::Locked)
+	{
+		return EGitState::CheckedOut;
+	}
+
+	if (IsSourceControlled())
+	{
+		if (CanCheckout())
+		{
+			return EGitState::Lockable;
+		}
+		return EGitState::Unmodified;
+	}
+
+	return EGitState::None;
+}
+
 int32 FFriendshipperSourceControlState::GetHistorySize() const
 {
 	return History.Num();
@@ -62,9 +229,9 @@ TSharedPtr<class ISourceControlRevision, ESPMode::ThreadSafe> FFriendshipperSour
 #else
 	#define GET_ICON_RETURN( NAME ) FSlateIcon(FAppStyle::GetAppStyleSetName(), NAME )
 #endif
-FSlateIcon FFriendshipperSourceControlState::GetIcon() const
+FSlateIcon FFriendshipperSourceControlState::MakeIcon(const EGitState::Type InGitState) const
 {
-	switch (GetGitState())
+	switch (InGitState)
 	{
 	case EGitState::NotAtHead:
 #if ENGINE_MINOR_VERSION >= 2
@@ -126,16 +293,16 @@ FSlateIcon FFriendshipperSourceControlState::GetIcon() const
 	}
 }
 
-FText FFriendshipperSourceControlState::GetDisplayName() const
+FText FFriendshipperSourceControlState::MakeDisplayName(const EGitState::Type InGitState) const
 {
-	switch (GetGitState())
+	switch (InGitState)
 	{
 	case EGitState::NotAtHead:
 		return LOCTEXT("NotCurrent", "Not current");
 	case EGitState::LockedOther:
-		return FText::Format(LOCTEXT("CheckedOutOther", "Checked out by: {0}"), FText::FromString(State.LockUser));
+		return FText::Format(LOCTEXT("CheckedOutOther", "Checked out by: {0}"), FText::FromString(State.GetLockUser()));
 	case EGitState::NotLatest:
-		return FText::Format(LOCTEXT("ModifiedOtherBranch", "Modified in branch: {0}"), FText::FromString(State.HeadBranch));
+		return FText::Format(LOCTEXT("ModifiedOtherBranch", "Modified in branch: {0}"), FText::FromString(State.GetHeadBranch()));
 	case EGitState::Unmerged:
 		return LOCTEXT("Conflicted", "Conflicted");
 	case EGitState::Added:
@@ -158,16 +325,16 @@ FText FFriendshipperSourceControlState::GetDisplayName() const
 	}
 }
 
-FText FFriendshipperSourceControlState::GetDisplayTooltip() const
+FText FFriendshipperSourceControlState::MakeDisplayTooltip(const EGitState::Type InGitState) const
 {
-	switch (GetGitState())
+	switch (InGitState)
 	{
 	case EGitState::NotAtHead:
 		return LOCTEXT("NotCurrent_Tooltip", "The file(s) are not at the head revision");
 	case EGitState::LockedOther:
-		return FText::Format(LOCTEXT("CheckedOutOther_Tooltip", "Checked out by: {0}"), FText::FromString(State.LockUser));
+		return FText::Format(LOCTEXT("CheckedOutOther_Tooltip", "Checked out by: {0}"), FText::FromString(State.GetLockUser()));
 	case EGitState::NotLatest:
-		return FText::Format(LOCTEXT("ModifiedOtherBranch_Tooltip", "Modified in branch: {0} CL:{1} ({2})"), FText::FromString(State.HeadBranch), FText::FromString(HeadCommit), FText::FromString(HeadAction));
+		return FText::Format(LOCTEXT("ModifiedOtherBranch_Tooltip", "Modified in branch: {0} CL:{1} ({2})"), FText::FromString(State.GetHeadBranch()), FText::FromString(HeadCommit), FText::FromString(HeadAction));
 	case EGitState::Unmerged:
 		return LOCTEXT("ContentsConflict_Tooltip", "The contents of the item conflict with updates received from the repository.");
 	case EGitState::Added:
@@ -190,6 +357,40 @@ FText FFriendshipperSourceControlState::GetDisplayTooltip() const
 	}
 }
 
+const FFriendshipperSourceControlState::FPresentation& FFriendshipperSourceControlState::GetPresentation() const
+{
+	if (!Presentation.IsSet())
+	{
+		const EGitState::Type GitState = State.GetGitState();
+		Presentation.Emplace(FPresentation{GitState, MakeIcon(GitState), MakeDisplayName(GitState), MakeDisplayTooltip(GitState)});
+	}
+	return Presentation.GetValue();
+}
+
+void FFriendshipperSourceControlState::SetState(const FFriendshipperState& InState)
+{
+	if (State != InState)
+	{
+		State = InState;
+		Presentation.Reset();
+	}
+}
+
+FSlateIcon FFriendshipperSourceControlState::GetIcon() const
+{
+	return GetPresentation().Icon;
+}
+
+FText FFriendshipperSourceControlState::GetDisplayName() const
+{
+	return GetPresentation().DisplayName;
+}
+
+FText FFriendshipperSourceControlState::GetDisplayTooltip() const
+{
+	return GetPresentation().DisplayTooltip;
+}
+
 const FString& FFriendshipperSourceControlState::GetFilename() const
 {
 	return LocalFilename;
@@ -226,26 +427,7 @@ bool FFriendshipperSourceControlState::CanCheckIn() const
 
 bool FFriendshipperSourceControlState::CanCheckout() const
 {
-	// Packages that don't exist on disk can't be checked out
-	if (State.TreeState == ETreeState::NotInRepo)
-	{
-		return false;
-	}
-
-	// untracked files go through the "mark for add" workflow
-	if (State.TreeState == ETreeState::Untracked)
-	{
-		return false;
-	}
-
-	if (State.LockState == ELockState::Unlockable)
-	{
-		// Everything is already available for check in (checked out).
-		return false;
-	}
-
-	// We don't want to allow checkout if the file is out-of-date, as modifying an out-of-date binary file will most likely result in a merge conflict
-	return State.LockState == ELockState::NotLocked && IsCurrent();
+	return State.CanCheckout();
 }
 
 bool FFriendshipperSourceControlState::IsCheckedOut() const
@@ -263,7 +445,7 @@ bool FFriendshipperSourceControlState::IsCheckedOutOther(FString* Who) const
 		// This is a very, very rare state (maybe impossible), but one that should be displayed properly.
 		if (State.LockState == ELockState::LockedOther || (State.LockState == ELockState::Locked && !IsModifiedInOtherBranch()))
 		{
-			*Who = State.LockUser;
+			*Who = State.GetLockUser();
 		}
 	}
 	return State.LockState == ELockState::LockedOther;
@@ -287,7 +469,7 @@ bool FFriendshipperSourceControlState::GetOtherBranchHeadModification(FString& H
 		return false;
 	}
 
-	HeadBranchOut = State.HeadBranch;
+	HeadBranchOut = State.GetHeadBranch();
 	ActionOut = HeadAction; // TODO: from ERemoteState
 	HeadChangeListOut = 0; // TODO: get head commit
 	return true;
@@ -295,19 +477,17 @@ bool FFriendshipperSourceControlState::GetOtherBranchHeadModification(FString& H
 
 bool FFriendshipperSourceControlState::IsCurrent() const
 {
-	return State.RemoteState != ERemoteState::NotAtHead && State.RemoteState != ERemoteState::NotLatest;
+	return State.IsCurrent();
 }
 
 bool FFriendshipperSourceControlState::IsSourceControlled() const
 {
-	return State.TreeState != ETreeState::Untracked && State.TreeState != ETreeState::Ignored && State.TreeState != ETreeState::NotInRepo;
+	return State.IsSourceControlled();
 }
 
 bool FFriendshipperSourceControlState::IsAdded() const
 {
-	// We don't stage files in this plugin on purpose, but treat untracked + locked files as added
-	return (State.TreeState == ETreeState::Staged) ||
-		(State.TreeState == ETreeState::Untracked && State.LockState == ELockState::Locked);
+	return State.IsAdded();
 }
 
 bool FFriendshipperSourceControlState::IsDeleted() const
@@ -339,7 +519,7 @@ bool FFriendshipperSourceControlState::CanDelete() const
 
 bool FFriendshipperSourceControlState::IsUnknown() const
 {
-	return State.FileState == EFileState::Unknown && State.TreeState == ETreeState::NotInRepo;
+	return State.IsUnknown();
 }
 
 bool FFriendshipperSourceControlState::IsModified() const
@@ -350,7 +530,7 @@ bool FFriendshipperSourceControlState::IsModified() const
 
 bool FFriendshipperSourceControlState::CanAdd() const
 {
-	return State.TreeState == ETreeState::Untracked;
+	return State.CanAdd();
 }
 
 bool FFriendshipperSourceControlState::IsConflicted() const
@@ -365,67 +545,4 @@ bool FFriendshipperSourceControlState::CanRevert() const
 	return CanCheckIn() || IsModified();
 }
 
-EGitState::Type FFriendshipperSourceControlState::GetGitState() const
-{
-	// No matter what, we must pull from remote, even if we have locked or if we have modified.
-	switch (State.RemoteState)
-	{
-	case ERemoteState::NotAtHead:
-		return EGitState::NotAtHead;
-	default:
-		break;
-	}
-
-	/** Someone else locked this file across branches. */
-	// We cannot push under any circumstance, if someone else has locked.
-	if (State.LockState == ELockState::LockedOther)
-	{
-		return EGitState::LockedOther;
-	}
-
-	// We could theoretically push, but we shouldn't.
-	if (State.RemoteState == ERemoteState::NotLatest)
-	{
-		return EGitState::NotLatest;
-	}
-
-	if (IsAdded())
-	{
-		return EGitState::Added;
-	}
-
-	switch (State.FileState)
-	{
-	case EFileState::Unmerged:
-		return EGitState::Unmerged;
-	case EFileState::Deleted:
-		return EGitState::Deleted;
-	case EFileState::Modified:
-		return EGitState::Modified;
-	default:
-		break;
-	}
-
-	if (State.TreeState == ETreeState::Untracked)
-	{
-		return EGitState::Untracked;
-	}
-
-	if (State.LockState == ELockState::Locked)
-	{
-		return EGitState::CheckedOut;
-	}
-
-	if (IsSourceControlled())
-	{
-		if (CanCheckout())
-		{
-			return EGitState::Lockable;
-		}
-		return EGitState::Unmodified;
-	}
-
-	return EGitState::None;
-}
-
 #undef LOCTEXT_NAMESPACE
@@ -7,11 +7,12 @@
 
 #include "FriendshipperSourceControlRevision.h"
 #include "Runtime/Launch/Resources/Version.h"
+#include "Textures/SlateIcon.h"
 
 /** A consolidation of state priorities. */
 namespace EGitState
 {
-	enum Type
+	enum Type : uint8
 	{
 		Unset,
 		NotAtHead,
@@ -40,7 +41,7 @@ namespace EGitState
 /** Corresponds to diff file states. */
 namespace EFileState
 {
-	enum Type
+	enum Type : uint8
 	{
 		Unset,
 		Unknown,
@@ -57,7 +58,7 @@ namespace EFileState
 /** Where in the world is this file? */
 namespace ETreeState
 {
-	enum Type
+	enum Type : uint8
 	{
 		Unset,
 		/** This file is synced to commit */
@@ -78,7 +79,7 @@ namespace ETreeState
 /** LFS locks status of this file */
 namespace ELockState
 {
-	enum Type
+	enum Type : uint8
 	{
 		Unset,
 		Unknown,
@@ -92,7 +93,7 @@ namespace ELockState
 /** What is this file doing at HEAD? */
 namespace ERemoteState
 {
-	enum Type
+	enum Type : uint8
 	{
 		Unset,
 		/** Up to date */
@@ -111,19 +112,103 @@ namespace ERemoteState
 	};
 }
 
-/** Combined state, for updating cache in a map. */
+/**
+ * Small table of interned strings (lock owners, branch names) shared by every file state, so states only store an index.
+ * Index 0 is always the empty string. Strings are never released, references returned by Get stay valid. Thread safe.
+ */
+class FFriendshipperNameTable
+{
+public:
+	FFriendshipperNameTable();
+
+	/** Names of the users holding LFS locks */
+	static FFriendshipperNameTable& LockUsers();
+
+	/** Names of the branches files can be modified in */
+	static FFriendshipperNameTable& Branches();
+
+	/** Get the index of a name, adding it to the table if needed */
+	uint16 Intern(const FString& InName);
+
+	/** Name at an index, empty if the index is unknown */
+	const FString& Get(uint16 InIndex) const;
+
+private:
+	mutable FRWLock Lock;
+	TArray<TUniquePtr<FString>> Names;
+	TMap<FString, uint16> Indices;
+};
+
+/** Combined state, for updating cache in a map. Packed, as there is one per file in the cache and in every update. */
 struct FFriendshipperState
 {
-	EFileState::Type FileState = EFileState::Unknown;
-	ETreeState::Type TreeState = ETreeState::NotInRepo;
-	ELockState::Type LockState = ELockState::Unknown;
+	FFriendshipperState()
+		: FileState(EFileState::Unknown)
+		, TreeState(ETreeState::NotInRepo)
+		, LockState(ELockState::Unknown)
+		, RemoteState(ERemoteState::UpToDate)
+	{
+	}
+
+	EFileState::Type FileState : 4;
+	ETreeState::Type TreeState : 4;
+	ELockState::Type LockState : 4;
+	ERemoteState::Type RemoteState : 4;
+
+	/** Index of the user who has locked the file in FFriendshipperNameTable::LockUsers() */
+	uint16 LockUserIndex = 0;
+	/** Index of the branch with the latest commit for this file in FFriendshipperNameTable::Branches() */
+	uint16 HeadBranchIndex = 0;
+
 	/** Name of user who has locked the file */
-	FString LockUser;
-	ERemoteState::Type RemoteState = ERemoteState::UpToDate;
+	const FString& GetLockUser() const
+	{
+		return FFriendshipperNameTable::LockUsers().Get(LockUserIndex);
+	}
+
+	void SetLockUser(const FString& InLockUser)
+	{
+		LockUserIndex = FFriendshipperNameTable::LockUsers().Intern(InLockUser);
+	}
+
 	/** The branch with the latest commit for this file */
-	FString HeadBranch;
+	const FString& GetHeadBranch() const
+	{
+		return FFriendshipperNameTable::Branches().Get(HeadBranchIndex);
+	}
+
+	void SetHeadBranch(const FString& InHeadBranch)
+	{
+		HeadBranchIndex = FFriendshipperNameTable::Branches().Intern(InHeadBranch);
+	}
+
+	/** Predicates on the packed state, shared by the state objects and the cache which doesn't always have one */
+	bool IsUnknown() const;
+	bool IsCurrent() const;
+	bool IsSourceControlled() const;
+	bool IsAdded() const;
+	bool CanAdd() const;
+	bool CanCheckout() const;
+
+	/** Consolidated state, for icons and to index the cache */
+	EGitState::Type GetGitState() const;
+
+	bool operator==(const FFriendshipperState& Other) const
+	{
+		return FileState == Other.FileState && TreeState == Other.TreeState && LockState == Other.LockState && RemoteState == Other.RemoteState
+			&& LockUserIndex == Other.LockUserIndex && HeadBranchIndex == Other.HeadBranchIndex;
+	}
+
+	bool operator!=(const FFriendshipperState& Other) const
+	{
+		return !(*this == Other);
+	}
 };
 
+/**
+ * State object handed out to the editor. The cache only keeps the packed FFriendshipperState of each file and creates
+ * these on demand, see FFriendshipperStateCache.
+ */
 class FFriendshipperSourceControlState : public ISourceControlState
 {
 public:
@@ -171,8 +256,41 @@ public:
 	virtual bool IsConflicted() const override;
 	virtual bool CanRevert() const override;
 
+	/** Status of the file */
+	const FFriendshipperState& GetState() const
+	{
+		return State;
+	}
+
+	/** Change the status of the file, dropping what was derived from the previous one if it differs */
+	void SetState(const FFriendshipperState& InState);
+
 private:
-	EGitState::Type GetGitState() const;
+	/** What the editor shows for a state, asked for every frame by the Content Browser tiles */
+	struct FPresentation
+	{
+		EGitState::Type GitState;
+		FSlateIcon Icon;
+		FText DisplayName;
+		FText DisplayTooltip;
+	};
+
+	EGitState::Type GetGitState() const
+	{
+		return GetPresentation().GitState;
+	}
+
+	/** Presentation of the current state, computed on first use. Only used from the game thread. */
+	const FPresentation& GetPresentation() const;
+
+	FSlateIcon MakeIcon(EGitState::Type InGitState) const;
+	FText MakeDisplayName(EGitState::Type InGitState) const;
+	FText MakeDisplayTooltip(EGitState::Type InGitState) const;
+
+	/** Status of the file */
+	FFriendshipperState State;
+
+	mutable TOptional<FPresentation> Presentation;
 
 public:
 	/** History of the item, if any */
@@ -181,9 +299,6 @@ public:
 	/** Filename on disk */
 	FString LocalFilename;
 
-	/** Status of the file */
-	FFriendshipperState State;
-
 	/** The timestamp of the last update */
 	FDateTime TimeStamp;
 
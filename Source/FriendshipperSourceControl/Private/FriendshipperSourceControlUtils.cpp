@@ -5,7 +5,10 @@
 
 #include "FriendshipperSourceControlUtils.h"
 
+#include "FriendshipperGitAttributes.h"
 #include "FriendshipperMessageLog.h"
+#include "FriendshipperPathTable.h"
+#include "FriendshipperRepoStatusIndex.h"
 #include "FriendshipperSourceControlCommand.h"
 #include "FriendshipperSourceControlModule.h"
 #include "FriendshipperSourceControlProvider.h"
@@ -24,13 +27,17 @@
 #include "Logging/MessageLog.h"
 #include "Misc/DateTime.h"
 #include "Misc/ScopeLock.h"
+#include "Misc/ScopeRWLock.h"
 #include "Misc/Timespan.h"
 
 #include "PackageTools.h"
+#include "SourceControlHelpers.h"
 #include "FileHelpers.h"
 #include "Misc/MessageDialog.h"
 
 #include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "HAL/IConsoleManager.h"
 #include "UObject/Linker.h"
 
 // Friendshipper
@@ -52,8 +59,16 @@ namespace GitSourceControlConstants
 {
 /** The maximum number of files we submit in a single Git command */
 const int32 MaxFilesPerBatch = 50;
+
+/** Number of files classified by each task when computing states for the whole repository */
+const int32 StatesPerTask = 2048;
 } // namespace GitSourceControlConstants
 
+static TAutoConsoleVariable<bool> CVarParallelStateComputation(
+	TEXT("Friendshipper.ParallelStateComputation"),
+	true,
+	TEXT("Compute file states on worker threads when refreshing the whole repository."));
+
 FFriendshipperScopedTempFile::FFriendshipperScopedTempFile(const FText& InText)
 {
 	Filename = FPaths::CreateTempFilename(*FPaths::ProjectLogDir(), TEXT("Git-Temp"), TEXT(".txt"));
@@ -127,6 +142,61 @@ namespace FriendshipperSourceControlUtils
 		return ChangeRepositoryRootIfSubmodule(AbsoluteFilePaths, PathToRepositoryRoot);
 	}
 
+/**
+ * Same as FPlatformProcess::ExecProcess, but terminates git if the command it runs for is cancelled while waiting for it.
+ * Returns false in that case, the outputs then only hold what git wrote before being terminated.
+ */
+static bool ExecCancellableProcess(const TCHAR* InURL, const TCHAR* InParams, int32& OutReturnCode, FString& OutStdOut, FString& OutStdErr)
+{
+	void* StdOutRead = nullptr;
+	void* StdOutWrite = nullptr;
+	void* StdErrRead = nullptr;
+	void* StdErrWrite = nullptr;
+	verify(FPlatformProcess::CreatePipe(StdOutRead, StdOutWrite));
+	verify(FPlatformProcess::CreatePipe(StdErrRead, StdErrWrite));
+
+	FProcHandle ProcHandle = FPlatformProcess::CreateProc(InURL, InParams, false, true, true, nullptr, 0, nullptr, StdOutWrite, nullptr, StdErrWrite);
+	if (!ProcHandle.IsValid())
+	{
+		FPlatformProcess::ClosePipe(StdOutRead, StdOutWrite);
+		FPlatformProcess::ClosePipe(StdErrRead, StdErrWrite);
+		OutReturnCode = -1;
+		return true;
+	}
+
+	bool bCancelled = false;
+	while (FPlatformProcess::IsProcRunning(ProcHandle))
+	{
+		if (FFriendshipperSourceControlCommand::IsCurrentCommandCanceled())
+		{
+			FPlatformProcess::TerminateProc(ProcHandle, true);
+			bCancelled = true;
+			break;
+		}
+
+		// Keep the pipes drained so that git never blocks on a full one
+		const FString NewStdOut = FPlatformProcess::ReadPipe(StdOutRead);
+		const FString NewStdErr = FPlatformProcess::ReadPipe(StdErrRead);
+		if (NewStdOut.IsEmpty() && NewStdErr.IsEmpty())
+		{
+			FPlatformProcess::Sleep(0.001f);
+		}
+		OutStdOut += NewStdOut;
+		OutStdErr += NewStdErr;
+	}
+	OutStdOut += FPlatformProcess::ReadPipe(StdOutRead);
+	OutStdErr += FPlatformProcess::ReadPipe(StdErrRead);
+
+	if (!bCancelled)
+	{
+		FPlatformProcess::GetProcReturnCode(ProcHandle, &OutReturnCode);
+	}
+	FPlatformProcess::CloseProc(ProcHandle);
+	FPlatformProcess::ClosePipe(StdOutRead, StdOutWrite);
+	FPlatformProcess::ClosePipe(StdErrRead, StdErrWrite);
+	return !bCancelled;
+}
+
 // Launch the Git command line process and extract its results & errors
 bool RunCommandInternalRaw(const FString& InCommand, const FString& InPathToGitBinary, const FString& InRepositoryRoot, const TArray<FString>& InParameters, const TArray<FString>& InFiles, FString& OutResults, FString& OutErrors, const int32 ExpectedReturnCode /* = 0 */)
 {
@@ -201,7 +271,11 @@ bool RunCommandInternalRaw(const FString& InCommand, const FString& InPathToGitB
 	}
 #endif
 
-	FPlatformProcess::ExecProcess(*PathToGitOrEnvBinary, *FullCommand, &ReturnCode, &OutResults, &OutErrors);
+	if (!ExecCancellableProcess(*PathToGitOrEnvBinary, *FullCommand, ReturnCode, OutResults, OutErrors))
+	{
+		UE_LOG(LogSourceControl, Log, TEXT("RunCommand(%s) cancelled"), *InCommand);
+		return false;
+	}
 
 #if UE_BUILD_DEBUG
 	// TODO: add a setting to easily enable Verbose logging
@@ -710,6 +784,12 @@ bool RunCommand(const FString& InCommand, const FString& InPathToGitBinary, cons
 		int32 FileCount = 0;
 		while (FileCount < InFiles.Num())
 		{
+			// Don't start git again for a cancelled command
+			if (FFriendshipperSourceControlCommand::IsCurrentCommandCanceled())
+			{
+				return false;
+			}
+
 			TArray<FString> FilesInBatch;
 			for (int32 FileIndex = 0; FileCount < InFiles.Num() && FileIndex < GitSourceControlConstants::MaxFilesPerBatch; FileIndex++, FileCount++)
 			{
@@ -903,133 +983,75 @@ bool ListFilesInDirectoryRecurse(const FString& InPathToGitBinary, const FString
 	return bResult;
 }
 
-// Called in case of a refresh of status on a list of assets in the Content Browser, periodic update, or user manually refreshed.
-static void ParseFileStatusResult(const TSet<FString>& InFiles, const FRepoStatus& InRepoStatus, TMap<FString, FFriendshipperSourceControlState>& OutStates)
+// Classify a single file against an indexed status. Only reads shared data, so it can run on several threads at once.
+// InKnownFiles is the listing of the last rescan (tracked and untracked files on disk): a file absent from the status lists
+// exists if it is listed there, so only files with local changes need to hit the filesystem. Without a listing, fall back to a stat.
+static FFriendshipperState ClassifyFile(const FFriendshipperPathId File, const FFriendshipperRepoStatusIndex& InStatusIndex, const TSet<FFriendshipperPathId>* InKnownFiles, const FFriendshipperGitAttributes* InAttributes, const FString& InLfsUserName)
 {
-	FFriendshipperSourceControlModule* GitSourceControl = FFriendshipperSourceControlModule::GetThreadSafe();
-	if (!GitSourceControl)
-	{
-		return;
-	}
-	FFriendshipperSourceControlProvider& Provider = GitSourceControl->GetProvider();
-	const FString& LfsUserName = Provider.GetLockUser();
-
-	TMap<FString, FString> LockedFiles;
+	const FFriendshipperPathTable& PathTable = InStatusIndex.GetPathTable();
 
-	FString Result;
+	FFriendshipperState State;
+	State.FileState = EFileState::Unset;
+	State.LockState = ELockState::Unset;
+	State.TreeState = InStatusIndex.FindTreeState(File);
 
-	// Iterate on all files explicitly listed in the command
-	for (const auto& File : InFiles)
+	const bool bFound = State.TreeState != ETreeState::Unset;
+	const bool bFileExists = (bFound || !InKnownFiles) ? FPaths::FileExists(PathTable.GetPath(File)) : InKnownFiles->Contains(File);
+	if (bFound)
 	{
-		FFriendshipperSourceControlState FileState(File);
-		FileState.State.FileState = EFileState::Unset;
-		FileState.State.TreeState = ETreeState::Unset;
-		FileState.State.LockState = ELockState::Unset;
-
-		bool bFound = false;
-		for (const FStatusFileState& StatusState : InRepoStatus.ModifiedFiles)
-		{
-			if (File.EndsWith(StatusState.Path))
-			{
-				FileState.State.TreeState = ETreeState::Working;
-				bFound = true;
-				break;
-			}
-		}
-		if (!bFound)
+		if (!bFileExists)
 		{
-			for (const FStatusFileState& StatusState : InRepoStatus.UntrackedFiles)
-			{
-				if (File.EndsWith(StatusState.Path))
-				{
-					FileState.State.TreeState = ETreeState::Untracked;
-					bFound = true;
-					break;
-				}
-			}
+			State.FileState = EFileState::Deleted;
 		}
-
-		const bool bFileExists = FPaths::FileExists(File);
-		if (bFound)
+	}
+	else
+	{
+		State.FileState = EFileState::Unknown;
+		// File not found in status
+		if (bFileExists)
 		{
-			if (!bFileExists)
-			{
-				FileState.State.FileState = EFileState::Deleted;
-			}
+			// usually means the file is unchanged,
+			State.TreeState = ETreeState::Unmodified;
 		}
 		else
 		{
-			FileState.State.FileState = EFileState::Unknown;
-			// File not found in status
-			if (bFileExists)
-			{
-				// usually means the file is unchanged,
-				FileState.State.TreeState = ETreeState::Unmodified;
-			}
-			else
-			{
-				// but also the case for newly created content: there is no file on disk until the content is saved for the first time
-				FileState.State.TreeState = ETreeState::NotInRepo;
-			}
+			// but also the case for newly created content: there is no file on disk until the content is saved for the first time
+			State.TreeState = ETreeState::NotInRepo;
 		}
+	}
 
-		if (IsFileLFSLockable(File))
+	if (InAttributes && InAttributes->IsLockable(File, PathTable))
+	{
+		if (const FString* LockUser = InStatusIndex.FindLockOwner(File))
 		{
-			if (LockedFiles.IsEmpty())
-			{
-				const FString ProjectDir = IFileManager::Get().ConvertToAbsolutePathForExternalAppForRead(*FPaths::ProjectDir());
-
-				LockedFiles.Reserve(InRepoStatus.LocksOurs.Num() + InRepoStatus.LocksTheirs.Num());
-				for (const FLfsLock& Lock : InRepoStatus.LocksOurs)
-				{
-					FString AbsolutePath = FPaths::ConvertRelativePathToFull(ProjectDir, Lock.Path);
-					LockedFiles.Add(AbsolutePath, Lock.Owner.Name);
-				}
-				for (const FLfsLock& Lock : InRepoStatus.LocksTheirs)
-				{
-					FString AbsolutePath = FPaths::ConvertRelativePathToFull(ProjectDir, Lock.Path);
-					LockedFiles.Add(AbsolutePath, Lock.Owner.Name);
-				}
-			}
-
-			if (const FString* LockUser = LockedFiles.Find(File))
+			State.SetLockUser(*LockUser);
+			if (InLfsUserName == *LockUser)
 			{
-				FileState.State.LockUser = *LockUser;
-				if (LfsUserName == FileState.State.LockUser)
-				{
-					FileState.State.LockState = ELockState::Locked;
-				}
-				else
-				{
-					FileState.State.LockState = ELockState::LockedOther;
-				}
+				State.LockState = ELockState::Locked;
 			}
 			else
 			{
-				FileState.State.LockState = ELockState::NotLocked;
+				State.LockState = ELockState::LockedOther;
 			}
 		}
 		else
 		{
-			FileState.State.LockState = ELockState::Unlockable;
+			State.LockState = ELockState::NotLocked;
 		}
-
-		OutStates.Add(File, MoveTemp(FileState));
 	}
-}
+	else
+	{
+		State.LockState = ELockState::Unlockable;
+	}
 
-void CheckRemote(const FString& InRepositoryRoot, const FRepoStatus& InStatus, TMap<FString, FFriendshipperSourceControlState>& OutStates)
-{
 	// We can obtain a list of files that were modified between our remote branches and HEAD. Assumes that fetch has been run to get accurate info.
-	for (const FString& Modified : InStatus.ModifiedUpstream)
+	if (InStatusIndex.IsModifiedUpstream(File))
 	{
-		const FString& AbsolutePath = FPaths::Combine(InRepositoryRoot, Modified);
-		if (FFriendshipperSourceControlState* FileState = OutStates.Find(AbsolutePath))
-		{
-			FileState->State.RemoteState = ERemoteState::NotAtHead;
-			FileState->State.HeadBranch = InStatus.RemoteBranch;
-		}
+		State.RemoteState = ERemoteState::NotAtHead;
+		State.SetHeadBranch(InStatusIndex.GetRemoteBranch());
 	}
+
+	return State;
 }
 
 void GetLockedFiles(const TArray<FString>& InFiles, TArray<FString>& OutFiles)
@@ -1037,20 +1059,19 @@ void GetLockedFiles(const TArray<FString>& InFiles, TArray<FString>& OutFiles)
 	FFriendshipperSourceControlModule& GitSourceControl = FFriendshipperSourceControlModule::Get();
 	FFriendshipperSourceControlProvider& Provider = GitSourceControl.GetProvider();
 
-	TArray<TSharedRef<ISourceControlState, ESPMode::ThreadSafe>> LocalStates;
-	Provider.GetState(InFiles, LocalStates, EStateCacheUsage::Use);
-	for (const auto& State : LocalStates)
+	// Called from workers, so read copies of the cached states rather than the state objects
+	for (const FString& File : SourceControlHelpers::AbsoluteFilenames(InFiles))
 	{
-		const auto& GitState = StaticCastSharedRef<FFriendshipperSourceControlState>(State);
-		if (GitState->State.LockState == ELockState::Locked)
+		FFriendshipperState State;
+		if (Provider.GetCachedState(File, State) && State.LockState == ELockState::Locked)
 		{
-			OutFiles.Add(GitState->GetFilename());
+			OutFiles.Add(File);
 		}
 	}
 }
 
 // Run a batch of Git "status" command to update status of given files and/or directories.
-bool RunUpdateStatus(const FString& InRepositoryRoot, const TArray<FString>& InFiles, EForceStatusRefresh FetchRemote, TMap<FString, FFriendshipperSourceControlState>& OutStates)
+bool RunUpdateStatus(const FString& InRepositoryRoot, const TArray<FString>& InFiles, EForceStatusRefresh FetchRemote, TMap<FFriendshipperPathId, FFriendshipperState>& OutStates)
 {
 	// Remove files that aren't in the repository
 	const TArray<FString>& RepoFiles = InFiles.FilterByPredicate([InRepositoryRoot](const FString& File) { return File.StartsWith(InRepositoryRoot); });
@@ -1063,37 +1084,106 @@ bool RunUpdateStatus(const FString& InRepositoryRoot, const TArray<FString>& InF
 	FFriendshipperSourceControlModule& GitSourceControl = FFriendshipperSourceControlModule::Get();
 	FFriendshipperSourceControlProvider& Provider = GitSourceControl.GetProvider();
 	FFriendshipperClient& Client = Provider.GetFriendshipperClient();
+	FFriendshipperPathTable& PathTable = FFriendshipperPathTable::Get();
 
 	const FString ProjectDir = IFileManager::Get().ConvertToAbsolutePathForExternalAppForRead(*FPaths::ProjectDir());
-	const TSet<FString> AllAbsolutePaths = Provider.GetAllPathsAbsolute();
+	// Empty until the first rescan completes, in which case existence is checked on disk
+	const FFriendshipperPathSetRef AllAbsolutePaths = Provider.GetAllPathsAbsolute();
 
-	TSet<FString> AbsolutePaths;
+	TSet<FFriendshipperPathId> AbsolutePaths;
+	TArray<FFriendshipperPathId> FilesUnder;
 	for (const FString& Filename : InFiles)
 	{
-		FString AbsolutePath = FPaths::ConvertRelativePathToFull(ProjectDir, Filename);
-		AbsolutePaths.Add(MoveTemp(AbsolutePath));
+		// Directories like the project Content/ come with a trailing slash
+		const FString AbsolutePath = FPaths::ConvertRelativePathToFull(ProjectDir, Filename);
+		const FStringView TrimmedPath = FFriendshipperPathTable::TrimTrailingSlashes(AbsolutePath);
+
+		// Only look paths up at first: the table never releases anything, requested directories shouldn't end up in it
+		const FFriendshipperPathId Path = PathTable.Find(TrimmedPath);
+		FilesUnder.Reset();
+		PathTable.GetFilesUnder(Path, FilesUnder);
+		if (FilesUnder.IsEmpty())
+		{
+			// Nothing known under it yet (first refresh, empty folder...): a directory still has no state of its own
+			if (TrimmedPath.Len() != AbsolutePath.Len() || IFileManager::Get().DirectoryExists(*FString(TrimmedPath)))
+			{
+				continue;
+			}
+			AbsolutePaths.Add(Path.IsValid() ? Path : PathTable.Intern(TrimmedPath));
+			continue;
+		}
+
+		// A directory stands for the tracked files under it, or for all the files known under it until the first rescan completes
+		AbsolutePaths.Reserve(AbsolutePaths.Num() + FilesUnder.Num());
+		for (const FFriendshipperPathId File : FilesUnder)
+		{
+			if (AllAbsolutePaths->IsEmpty() || AllAbsolutePaths->Contains(File))
+			{
+				AbsolutePaths.Add(File);
+			}
+		}
 	}
 
 	FRepoStatus RepoStatus;
 	const bool bIsStatusValid = Client.GetStatus(FetchRemote, RepoStatus);
 	if (bIsStatusValid)
 	{
-		ParseFileStatusResult(AbsolutePaths, RepoStatus, OutStates);
-		CheckRemote(InRepositoryRoot, RepoStatus, OutStates);
+		const FFriendshipperRepoStatusIndex StatusIndex(InRepositoryRoot, RepoStatus);
+		OutStates.Append(FriendshipperStatesFromStatusIndex(AbsolutePaths, AllAbsolutePaths->IsEmpty() ? nullptr : &AllAbsolutePaths.Get(), StatusIndex));
 	}
 
 	return bIsStatusValid;
 }
 
-TMap<const FString, FFriendshipperState> FriendshipperStatesFromRepoStatus(const FString& InRepositoryRoot, const TSet<FString>& AllTrackedFilesAbsolutePaths, const FRepoStatus& RepoStatus)
+TMap<FFriendshipperPathId, FFriendshipperState> FriendshipperStatesFromRepoStatus(const FString& InRepositoryRoot, const TSet<FFriendshipperPathId>& AllTrackedFiles, const FRepoStatus& RepoStatus)
+{
+	const FFriendshipperRepoStatusIndex StatusIndex(InRepositoryRoot, RepoStatus);
+	return FriendshipperStatesFromStatusIndex(AllTrackedFiles, &AllTrackedFiles, StatusIndex);
+}
+
+TMap<FFriendshipperPathId, FFriendshipperState> FriendshipperStatesFromStatusIndex(const TSet<FFriendshipperPathId>& InFiles, const TSet<FFriendshipperPathId>* AllTrackedFiles, const FFriendshipperRepoStatusIndex& StatusIndex)
 {
-	TMap<FString, FFriendshipperSourceControlState> SCCStates;
+	TMap<FFriendshipperPathId, FFriendshipperState> States;
 
-	ParseFileStatusResult(AllTrackedFilesAbsolutePaths, RepoStatus, SCCStates);
-	CheckRemote(InRepositoryRoot, RepoStatus, SCCStates);
+	FFriendshipperSourceControlModule* GitSourceControl = FFriendshipperSourceControlModule::GetThreadSafe();
+	if (!GitSourceControl)
+	{
+		return States;
+	}
+	const FString LfsUserName = GitSourceControl->GetProvider().GetLockUser();
+	const TSharedPtr<const FFriendshipperGitAttributes, ESPMode::ThreadSafe> Attributes = GetGitAttributes();
 
-	TMap<const FString, FFriendshipperState> States;
-	FriendshipperSourceControlUtils::CollectNewStates(SCCStates, States);
+	// Sets can't be split in ranges, so flatten them once to let each task work on its own slice
+	const TArray<FFriendshipperPathId> Files = InFiles.Array();
+
+	// Every task writes to its own shard, which are merged in the result once at the end
+	const int32 NumShards = FMath::DivideAndRoundUp(Files.Num(), GitSourceControlConstants::StatesPerTask);
+	TArray<TArray<TPair<FFriendshipperPathId, FFriendshipperState>>> Shards;
+	Shards.SetNum(NumShards);
+
+	const EParallelForFlags Flags = (NumShards > 1 && CVarParallelStateComputation.GetValueOnAnyThread()) ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread;
+	ParallelFor(NumShards, [&](const int32 ShardIndex)
+		{
+			const int32 First = ShardIndex * GitSourceControlConstants::StatesPerTask;
+			const int32 Last = FMath::Min(First + GitSourceControlConstants::StatesPerTask, Files.Num());
+
+			TArray<TPair<FFriendshipperPathId, FFriendshipperState>>& Shard = Shards[ShardIndex];
+			Shard.Reserve(Last - First);
+			for (int32 Index = First; Index < Last; ++Index)
+			{
+				Shard.Emplace(Files[Index], ClassifyFile(Files[Index], StatusIndex, AllTrackedFiles, Attributes.Get(), LfsUserName));
+			}
+		},
+		Flags);
+
+	States.Reserve(Files.Num());
+	for (TArray<TPair<FFriendshipperPathId, FFriendshipperState>>& Shard : Shards)
+	{
+		for (TPair<FFriendshipperPathId, FFriendshipperState>& Pair : Shard)
+		{
+			States.Add(Pair.Key, MoveTemp(Pair.Value));
+		}
+	}
 
 	return States;
 }
@@ -1501,7 +1591,7 @@ TArray<FString> AbsoluteFilenames(const TArray<FString>& InFileNames, const FStr
 	return AbsFiles;
 }
 
-bool UpdateCachedStates(const TMap<const FString, FFriendshipperState>& InResults)
+bool UpdateCachedStates(const TMap<FFriendshipperPathId, FFriendshipperState>& InResults)
 {
 	FFriendshipperSourceControlModule* GitSourceControl = FFriendshipperSourceControlModule::GetThreadSafe();
 	if (!GitSourceControl)
@@ -1512,16 +1602,10 @@ bool UpdateCachedStates(const TMap<const FString, FFriendshipperState>& InResult
 	return Provider.UpdateCachedStates(InResults);
 }
 
-void CollectNewStates(const TMap<FString, FFriendshipperSourceControlState>& InStates, TMap<const FString, FFriendshipperState>& OutResults)
+void CollectNewStates(const TArray<FString>& InFiles, TMap<FFriendshipperPathId, FFriendshipperState>& OutResults, EFileState::Type FileState, ETreeState::Type TreeState, ELockState::Type LockState, ERemoteState::Type RemoteState)
 {
-	for (const auto& InState : InStates)
-	{
-		OutResults.Add(InState.Key, InState.Value.State);
-	}
-}
+	FFriendshipperPathTable& PathTable = FFriendshipperPathTable::Get();
 
-void CollectNewStates(const TArray<FString>& InFiles, TMap<const FString, FFriendshipperState>& OutResults, EFileState::Type FileState, ETreeState::Type TreeState, ELockState::Type LockState, ERemoteState::Type RemoteState)
-{
 	FFriendshipperState NewState;
 	NewState.FileState = FileState;
 	NewState.TreeState = TreeState;
@@ -1530,7 +1614,7 @@ void CollectNewStates(const TArray<FString>& InFiles, TMap<const FString, FFrien
 
 	for (const auto& File : InFiles)
 	{
-		FFriendshipperState& State = OutResults.FindOrAdd(File, NewState);
+		FFriendshipperState& State = OutResults.FindOrAdd(PathTable.Intern(File), NewState);
 		if (NewState.FileState != EFileState::Unset)
 		{
 			State.FileState = NewState.FileState;
@@ -1593,43 +1677,27 @@ void RemoveRedundantErrors(FFriendshipperSourceControlCommand& InCommand, const
 	}
 }
 
-static TArray<FString> LockableTypes;
+static FRWLock GitAttributesLock;
+static TSharedPtr<const FFriendshipperGitAttributes, ESPMode::ThreadSafe> GitAttributes;
 
-bool IsFileLFSLockable(const FString& InFile)
+TSharedPtr<const FFriendshipperGitAttributes, ESPMode::ThreadSafe> GetGitAttributes()
 {
-	for (const auto& Type : LockableTypes)
-	{
-		if (InFile.EndsWith(Type))
-		{
-			return true;
-		}
-	}
-	return false;
+	FReadScopeLock Lock(GitAttributesLock);
+	return GitAttributes;
 }
 
-bool CheckLFSLockable(const FString& InPathToGitBinary, const FString& InRepositoryRoot, const TArray<FString>& InFiles, TArray<FString>& OutErrorMessages)
+void LoadGitAttributes(const FString& InPathToGitBinary, const FString& InRepositoryRoot)
 {
-	TArray<FString> Results;
-	TArray<FString> Parameters;
-	Parameters.Add(TEXT("lockable")); // follow file renames
-
-	const bool bResults = RunCommand(TEXT("check-attr"), InPathToGitBinary, InRepositoryRoot, Parameters, InFiles, Results, OutErrorMessages);
-	if (!bResults)
-	{
-		return false;
-	}
+	TSharedPtr<const FFriendshipperGitAttributes, ESPMode::ThreadSafe> Loaded = FFriendshipperGitAttributes::Load(InPathToGitBinary, InRepositoryRoot);
 
-	for (int i = 0; i < InFiles.Num(); i++)
-	{
-		const FString& Result = Results[i];
-		if (Result.EndsWith("set"))
-		{
-			const FString FileExt = InFiles[i].RightChop(1); // Remove wildcard (*)
-			LockableTypes.Add(FileExt);
-		}
-	}
+	FWriteScopeLock Lock(GitAttributesLock);
+	GitAttributes = MoveTemp(Loaded);
+}
 
-	return true;
+bool IsFileLFSLockable(FStringView InFile)
+{
+	const TSharedPtr<const FFriendshipperGitAttributes, ESPMode::ThreadSafe> Attributes = GetGitAttributes();
+	return Attributes.IsValid() && Attributes->IsLockable(InFile);
 }
 
 TSharedPtr<ISourceControlRevision, ESPMode::ThreadSafe> GetOriginRevisionOnBranch( const FString & InPathToGitBinary, const FString & InRepositoryRoot, const FString & InRelativeFileName, TArray<FString> & OutErrorMessages, const FString & BranchName )
@@ -5,12 +5,14 @@
 
 #pragma once
 
+#include "FriendshipperPathTable.h"
 #include "FriendshipperSourceControlRevision.h"
 #include "FriendshipperSourceControlState.h"
 
 class FFriendshipperSourceControlState;
 class FFriendshipperSourceControlCommand;
 struct FRepoStatus;
+class FFriendshipperRepoStatusIndex;
 enum class EForceStatusRefresh : uint8;
 
 /**
@@ -195,9 +197,18 @@ namespace FriendshipperSourceControlUtils
 	 * @param   OutStates           The resultant states
 	 * @returns true if the command succeeded and returned no errors
 	 */
-	bool RunUpdateStatus(const FString& InRepositoryRoot, const TArray<FString>& InFiles, EForceStatusRefresh FetchRemote, TMap<FString, FFriendshipperSourceControlState>& OutStates);
+	bool RunUpdateStatus(const FString& InRepositoryRoot, const TArray<FString>& InFiles, EForceStatusRefresh FetchRemote, TMap<FFriendshipperPathId, FFriendshipperState>& OutStates);
 
-	TMap<const FString, FFriendshipperState> FriendshipperStatesFromRepoStatus(const FString& InRepositoryRoot, const TSet<FString>& AllTrackedFilesAbsolutePaths, const FRepoStatus& RepoStatus);
+	TMap<FFriendshipperPathId, FFriendshipperState> FriendshipperStatesFromRepoStatus(const FString& InRepositoryRoot, const TSet<FFriendshipperPathId>& AllTrackedFiles, const FRepoStatus& RepoStatus);
+
+	/**
+	 * Compute the states of some files from an already indexed status (see FFriendshipperRepoStatusIndex).
+	 *
+	 * @param	InFiles				The files to compute the state of, interned absolute paths
+	 * @param	AllTrackedFiles		Listing of the files on disk from the last rescan, used to tell which files exist. If null, files are checked on disk.
+	 * @param	StatusIndex			The status to compute states from
+	 */
+	TMap<FFriendshipperPathId, FFriendshipperState> FriendshipperStatesFromStatusIndex(const TSet<FFriendshipperPathId>& InFiles, const TSet<FFriendshipperPathId>* AllTrackedFiles, const FFriendshipperRepoStatusIndex& StatusIndex);
 
 	/**
 	 * Run a Git "cat-file" command to dump the binary content of a revision into a file.
@@ -250,17 +261,12 @@ namespace FriendshipperSourceControlUtils
 	 * Helper function for various commands to update cached states.
 	 * @returns true if any states were updated
 	 */
-	bool UpdateCachedStates(const TMap<const FString, FFriendshipperState>& InResults);
-
-	/**
-	* Helper function for various commands to collect new states.
-	*/
-	void CollectNewStates(const TMap<FString, FFriendshipperSourceControlState>& InStates, TMap<const FString, FFriendshipperState>& OutResults);
+	bool UpdateCachedStates(const TMap<FFriendshipperPathId, FFriendshipperState>& InResults);
 
 	/**
 	 * Helper function for various commands to collect new states.
 	 */
-	void CollectNewStates(const TArray<FString>& InFiles, TMap<const FString, FFriendshipperState>& OutResults, EFileState::Type FileState, ETreeState::Type TreeState = ETreeState::Unset, ELockState::Type LockState = ELockState::Unset, ERemoteState::Type RemoteState = ERemoteState::Unset);
+	void CollectNewStates(const TArray<FString>& InFiles, TMap<FFriendshipperPathId, FFriendshipperState>& OutResults, EFileState::Type FileState, ETreeState::Type TreeState = ETreeState::Unset, ELockState::Type LockState = ELockState::Unset, ERemoteState::Type RemoteState = ERemoteState::Unset);
 
 	/**
 		 * Run 'git lfs locks" to extract all lock information for all files in the repository
@@ -279,14 +285,19 @@ namespace FriendshipperSourceControlUtils
 	void GetLockedFiles(const TArray<FString>& InFiles, TArray<FString>& OutFiles);
 
 	/**
-	 * Checks cache for if this file type is lockable
+	 * Checks the compiled .gitattributes for if this file is lockable
+	 */
+	bool IsFileLFSLockable(FStringView InFile);
+
+	/**
+	 * Parse the .gitattributes files of the repository, replacing the ones used by IsFileLFSLockable
 	 */
-	bool IsFileLFSLockable(const FString& InFile);
+	void LoadGitAttributes(const FString& InPathToGitBinary, const FString& InRepositoryRoot);
 
 	/**
-	 * Gets Git attribute to see if these extensions are lockable
+	 * Gets the attributes last loaded by LoadGitAttributes, if any
 	 */
-	bool CheckLFSLockable(const FString& InPathToGitBinary, const FString& InRepositoryRoot, const TArray<FString>& InFiles, TArray<FString>& OutErrorMessages);
+	TSharedPtr<const class FFriendshipperGitAttributes, ESPMode::ThreadSafe> GetGitAttributes();
 
 	TSharedPtr< class ISourceControlRevision, ESPMode::ThreadSafe > GetOriginRevisionOnBranch( const FString & InPathToGitBinary, const FString & InRepositoryRoot, const FString & InRelativeFileName, TArray< FString > & OutErrorMessages, const FString & BranchName );
 }
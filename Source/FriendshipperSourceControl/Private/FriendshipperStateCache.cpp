@@ -0,0 +1,301 @@
+// Copyright The Believer Company. All Rights Reserved.
+
+#include "FriendshipperStateCache.h"
+
+#include "Misc/ScopeRWLock.h"
+
+FFriendshipperStateCache::FStateRef FFriendshipperStateCache::GetOrMakeObject(const FShard& InShard, const FFriendshipperPathId InPath, const FEntry& InEntry)
+{
+	if (TSharedPtr<FFriendshipperSourceControlState, ESPMode::ThreadSafe> Object = InEntry.Object.Pin())
+	{
+		return Object.ToSharedRef();
+	}
+
+	// Not MakeShared: the weak reference left in the entry must not keep the whole object allocated
+	FStateRef Object = MakeShareable(new FFriendshipperSourceControlState(FFriendshipperPathTable::Get().GetPath(InPath)));
+	Object->SetState(InEntry.State);
+	Object->TimeStamp = InEntry.TimeStamp;
+	if (const TGitSourceControlHistory* History = InShard.Histories.Find(InPath))
+	{
+		Object->History = *History;
+	}
+	InEntry.Object = Object;
+	return Object;
+}
+
+void FFriendshipperStateCache::SyncObject(const FEntry& InEntry)
+{
+	if (TSharedPtr<FFriendshipperSourceControlState, ESPMode::ThreadSafe> Object = InEntry.Object.Pin())
+	{
+		Object->SetState(InEntry.State);
+		Object->TimeStamp = InEntry.TimeStamp;
+	}
+	else
+	{
+		// Release what is left of an object nobody references anymore
+		InEntry.Object.Reset();
+	}
+}
+
+bool FFriendshipperStateCache::HasPendingWork(const FFriendshipperState& InState)
+{
+	switch (InState.TreeState)
+	{
+	case ETreeState::Working:
+	case ETreeState::Staged:
+	case ETreeState::Untracked:
+		return true;
+	default:
+		break;
+	}
+
+	switch (InState.LockState)
+	{
+	case ELockState::Locked:
+	case ELockState::LockedOther:
+		return true;
+	default:
+		break;
+	}
+
+	// Unset and UpToDate both mean nothing to pull
+	if (InState.RemoteState != ERemoteState::Unset && InState.RemoteState != ERemoteState::UpToDate)
+	{
+		return true;
+	}
+
+	return InState.FileState != EFileState::Unset && InState.FileState != EFileState::Unknown;
+}
+
+void FFriendshipperStateCache::FShard::Reindex(const FFriendshipperPathId InPath, const FFriendshipperState& InState)
+{
+	if (HasPendingWork(InState))
+	{
+		Indexed.Add(InPath);
+	}
+	else
+	{
+		Indexed.Remove(InPath);
+	}
+}
+
+FFriendshipperStateCache::FStateRef FFriendshipperStateCache::FindOrAdd(const FFriendshipperPathId InPath)
+{
+	FShard& Shard = Shards[GetShardIndex(InPath)];
+	{
+		FReadScopeLock Lock(Shard.Lock);
+		if (const FEntry* Entry = Shard.States.Find(InPath))
+		{
+			if (TSharedPtr<FFriendshipperSourceControlState, ESPMode::ThreadSafe> Object = Entry->Object.Pin())
+			{
+				return Object.ToSharedRef();
+			}
+		}
+	}
+
+	FWriteScopeLock Lock(Shard.Lock);
+	const FEntry* Entry = Shard.States.Find(InPath);
+	if (!Entry)
+	{
+		Entry = &Shard.States.Add(InPath);
+		Shard.Reindex(InPath, Entry->State);
+	}
+	return GetOrMakeObject(Shard, InPath, *Entry);
+}
+
+void FFriendshipperStateCache::GetStateObjects(const bool bInIndexedOnly, TArray<FStateRef>& OutStates) const
+{
+	TArray<FFriendshipperPathId> Missing;
+	for (const FShard& Shard : Shards)
+	{
+		// Collect the live objects under the read lock, so that concurrent readers of the shard aren't blocked
+		Missing.Reset();
+		{
+			FReadScopeLock Lock(Shard.Lock);
+			auto Collect = [&OutStates, &Missing](const FFriendshipperPathId InPath, const FEntry& InEntry)
+			{
+				if (TSharedPtr<FFriendshipperSourceControlState, ESPMode::ThreadSafe> Object = InEntry.Object.Pin())
+				{
+					OutStates.Add(Object.ToSharedRef());
+				}
+				else
+				{
+					Missing.Add(InPath);
+				}
+			};
+
+			if (bInIndexedOnly)
+			{
+				for (const FFriendshipperPathId Path : Shard.Indexed)
+				{
+					Collect(Path, Shard.States.FindChecked(Path));
+				}
+			}
+			else
+			{
+				for (const TPair<FFriendshipperPathId, FEntry>& Pair : Shard.States)
+				{
+					Collect(Pair.Key, Pair.Value);
+				}
+			}
+		}
+
+		if (Missing.IsEmpty())
+		{
+			continue;
+		}
+
+		// Then only take the write lock to create the objects nobody references anymore
+		FWriteScopeLock Lock(Shard.Lock);
+		for (const FFriendshipperPathId Path : Missing)
+		{
+			// Removed in between
+			if (const FEntry* Entry = Shard.States.Find(Path))
+			{
+				OutStates.Add(GetOrMakeObject(Shard, Path, *Entry));
+			}
+		}
+	}
+}
+
+bool FFriendshipperStateCache::CopyState(const FFriendshipperPathId InPath, FFriendshipperState& OutState) const
+{
+	const FShard& Shard = Shards[GetShardIndex(InPath)];
+	FReadScopeLock Lock(Shard.Lock);
+	if (const FEntry* Entry = Shard.States.Find(InPath))
+	{
+		OutState = Entry->State;
+		return true;
+	}
+	return false;
+}
+
+bool FFriendshipperStateCache::Remove(const FFriendshipperPathId InPath)
+{
+	FShard& Shard = Shards[GetShardIndex(InPath)];
+	FWriteScopeLock Lock(Shard.Lock);
+
+	const FEntry* Entry = Shard.States.Find(InPath);
+	if (!Entry)
+	{
+		return false;
+	}
+	Shard.Indexed.Remove(InPath);
+	Shard.States.Remove(InPath);
+	Shard.Histories.Remove(InPath);
+	return true;
+}
+
+void FFriendshipperStateCache::Empty()
+{
+	for (FShard& Shard : Shards)
+	{
+		FWriteScopeLock Lock(Shard.Lock);
+		Shard.States.Empty();
+		Shard.Histories.Empty();
+		Shard.Indexed.Empty();
+	}
+}
+
+int32 FFriendshipperStateCache::Num() const
+{
+	int32 Num = 0;
+	for (const FShard& Shard : Shards)
+	{
+		FReadScopeLock Lock(Shard.Lock);
+		Num += Shard.States.Num();
+	}
+	return Num;
+}
+
+void FFriendshipperStateCache::ForEach(TFunctionRef<void(FFriendshipperPathId, const FFriendshipperCachedState&)> InFunc) const
+{
+	for (const FShard& Shard : Shards)
+	{
+		FReadScopeLock Lock(Shard.Lock);
+		for (const TPair<FFriendshipperPathId, FEntry>& Pair : Shard.States)
+		{
+			InFunc(Pair.Key, Pair.Value);
+		}
+	}
+}
+
+void FFriendshipperStateCache::Update(const TMap<FFriendshipperPathId, FFriendshipperState>& InStates, TFunctionRef<void(FFriendshipperPathId, FFriendshipperCachedState&, const FFriendshipperState&)> InFunc)
+{
+	// Bucket the states by shard first, so that each lock is only taken once
+	TArray<const TPair<FFriendshipperPathId, FFriendshipperState>*> Buckets[NumShards];
+	for (const TPair<FFriendshipperPathId, FFriendshipperState>& Pair : InStates)
+	{
+		Buckets[GetShardIndex(Pair.Key)].Add(&Pair);
+	}
+
+	for (int32 ShardIndex = 0; ShardIndex < NumShards; ++ShardIndex)
+	{
+		if (Buckets[ShardIndex].IsEmpty())
+		{
+			continue;
+		}
+
+		FShard& Shard = Shards[ShardIndex];
+		FWriteScopeLock Lock(Shard.Lock);
+		for (const TPair<FFriendshipperPathId, FFriendshipperState>* Pair : Buckets[ShardIndex])
+		{
+			FEntry* Entry = Shard.States.Find(Pair->Key);
+			const bool bAdded = !Entry;
+			if (bAdded)
+			{
+				Entry = &Shard.States.Add(Pair->Key);
+			}
+
+			const FFriendshipperState OldState = Entry->State;
+			InFunc(Pair->Key, *Entry, Pair->Value);
+
+			if (bAdded || Entry->State != OldState)
+			{
+				Shard.Reindex(Pair->Key, Entry->State);
+			}
+			SyncObject(*Entry);
+		}
+	}
+}
+
+void FFriendshipperStateCache::SetHistory(const FFriendshipperPathId InPath, const TGitSourceControlHistory& InHistory, const FDateTime& InTimeStamp)
+{
+	FShard& Shard = Shards[GetShardIndex(InPath)];
+	FWriteScopeLock Lock(Shard.Lock);
+
+	FEntry* Entry = Shard.States.Find(InPath);
+	if (!Entry)
+	{
+		Entry = &Shard.States.Add(InPath);
+		Shard.Reindex(InPath, Entry->State);
+	}
+	Entry->TimeStamp = InTimeStamp;
+
+	if (InHistory.IsEmpty())
+	{
+		Shard.Histories.Remove(InPath);
+	}
+	else
+	{
+		Shard.Histories.Add(InPath, InHistory);
+	}
+
+	SyncObject(*Entry);
+	if (TSharedPtr<FFriendshipperSourceControlState, ESPMode::ThreadSafe> Object = Entry->Object.Pin())
+	{
+		Object->History = InHistory;
+	}
+}
+
+void FFriendshipperStateCache::ForEachIndexed(TFunctionRef<void(FFriendshipperPathId, const FFriendshipperCachedState&)> InFunc) const
+{
+	for (const FShard& Shard : Shards)
+	{
+		FReadScopeLock Lock(Shard.Lock);
+		for (const FFriendshipperPathId Path : Shard.Indexed)
+		{
+			InFunc(Path, Shard.States.FindChecked(Path));
+		}
+	}
+}
@@ -0,0 +1,112 @@
+// Copyright The Believer Company. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FriendshipperPathTable.h"
+#include "FriendshipperSourceControlState.h"
+
+/** What the cache keeps for every known file */
+struct FFriendshipperCachedState
+{
+	FFriendshipperState State;
+
+	/** The timestamp of the last update */
+	FDateTime TimeStamp = FDateTime(0);
+};
+
+/**
+ * Cache of the states of every known file, sharded by path id with a lock per shard.
+ *
+ * Only the packed states are kept. The FFriendshipperSourceControlState objects the editor asks for are created on
+ * demand and only referenced weakly, so the files nobody looks at, most of the repository, don't pay for them. While
+ * an object is referenced, it is the one handed out for its file and Update keeps it in sync.
+ *
+ * The game thread is the only one writing states, through Update. Other threads can find, add and remove entries, and
+ * read states with CopyState, which copies the packed state under the shard lock.
+ *
+ * Files with pending work (modified, locked, deleted, not at head...) are also indexed, so they can be listed without
+ * going through the clean files making up most of the repository.
+ */
+class FFriendshipperStateCache
+{
+public:
+	using FStateRef = TSharedRef<FFriendshipperSourceControlState, ESPMode::ThreadSafe>;
+
+	/** Get the state object of a path, creating it if it isn't referenced anymore. Caches an unknown state if there is none yet. */
+	FStateRef FindOrAdd(FFriendshipperPathId InPath);
+
+	/**
+	 * Get the state objects of every cached state, or only of those with pending work. Objects not referenced
+	 * anymore are created again, prefer the packed states of ForEach when an ISourceControlState isn't required.
+	 * Getting every state allocates an object and rebuilds the path of most files of the repository, only the
+	 * indexed states should be asked for on any regular code path.
+	 */
+	void GetStateObjects(bool bInIndexedOnly, TArray<FStateRef>& OutStates) const;
+
+	/** Copy the current state of a path, false if it isn't cached. Safe to call from any thread. */
+	bool CopyState(FFriendshipperPathId InPath, FFriendshipperState& OutState) const;
+
+	bool Remove(FFriendshipperPathId InPath);
+	void Empty();
+	int32 Num() const;
+
+	/** Call InFunc on every cached state, one shard at a time. InFunc must not modify the cache. */
+	void ForEach(TFunctionRef<void(FFriendshipperPathId, const FFriendshipperCachedState&)> InFunc) const;
+
+	/**
+	 * Write new states to the cache (added if needed) and to their referenced state objects, locking each shard once.
+	 * InFunc runs under the shard lock and must not call back into the cache.
+	 */
+	void Update(const TMap<FFriendshipperPathId, FFriendshipperState>& InStates, TFunctionRef<void(FFriendshipperPathId, FFriendshipperCachedState&, const FFriendshipperState&)> InFunc);
+
+	/** Set the history of a path (added if needed), kept apart from the states as few files ever have one */
+	void SetHistory(FFriendshipperPathId InPath, const TGitSourceControlHistory& InHistory, const FDateTime& InTimeStamp);
+
+	/**
+	 * Is a state indexed: anything that is not a clean file at head, going by the raw working tree, lock and remote
+	 * facts rather than by the EGitState category, which hides local modifications behind Lockable or Unmodified when
+	 * the file isn't locked. Every state ISourceControlState reports as modified, added, deleted, checked out or not
+	 * current is indexed.
+	 */
+	static bool HasPendingWork(const FFriendshipperState& InState);
+
+	/** Call InFunc on every cached state with pending work. InFunc must not modify the cache. */
+	void ForEachIndexed(TFunctionRef<void(FFriendshipperPathId, const FFriendshipperCachedState&)> InFunc) const;
+
+private:
+	static constexpr int32 NumShardsLog2 = 6;
+	static constexpr int32 NumShards = 1 << NumShardsLog2;
+
+	struct FEntry : FFriendshipperCachedState
+	{
+		/** The state object last handed out for the path. Mutable: objects are created on demand by const queries too. */
+		mutable TWeakPtr<FFriendshipperSourceControlState, ESPMode::ThreadSafe> Object;
+	};
+
+	struct FShard
+	{
+		mutable FRWLock Lock;
+		TMap<FFriendshipperPathId, FEntry> States;
+		TMap<FFriendshipperPathId, TGitSourceControlHistory> Histories;
+		/** Paths of the states with pending work */
+		TSet<FFriendshipperPathId> Indexed;
+
+		/** Index or unindex a path after its state changed */
+		void Reindex(FFriendshipperPathId InPath, const FFriendshipperState& InState);
+	};
+
+	static int32 GetShardIndex(FFriendshipperPathId InPath)
+	{
+		// Ids are allocated sequentially, spread them with a multiplicative hash
+		return static_cast<int32>((InPath.Index * 2654435761u) >> (32 - NumShardsLog2));
+	}
+
+	/** Get the referenced state object of an entry, or create one. Needs the shard write lock. */
+	static FStateRef GetOrMakeObject(const FShard& InShard, FFriendshipperPathId InPath, const FEntry& InEntry);
+
+	/** Write a changed state to its state object, if it is still referenced. Needs the shard write lock. */
+	static void SyncObject(const FEntry& InEntry);
+
+	FShard Shards[NumShards];
+};
@@ -0,0 +1,288 @@
+// Copyright The Believer Company. All Rights Reserved.
+
+#include "FriendshipperStateCacheFile.h"
+
+#include "Async/MappedFileHandle.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "ISourceControlModule.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+namespace
+{
+constexpr uint32 FileMagic = 0x43534646; // "FFSC"
+constexpr uint32 FileVersion = 1;
+
+/** Gives file local indices to paths and all their parents, parents first */
+struct FPathWriter
+{
+	TMap<FFriendshipperPathId, int32> Indices;
+	TArray<int32> Parents;
+	TArray<FString> Names;
+
+	int32 Add(const FFriendshipperPathId InPath)
+	{
+		if (const int32* Found = Indices.Find(InPath))
+		{
+			return *Found;
+		}
+
+		const FFriendshipperPathTable& PathTable = FFriendshipperPathTable::Get();
+		const FFriendshipperPathId Parent = PathTable.GetParent(InPath);
+		const int32 ParentIndex = Parent.IsValid() ? Add(Parent) : INDEX_NONE;
+
+		const int32 Index = Names.Emplace(PathTable.GetName(InPath));
+		Parents.Add(ParentIndex);
+		Indices.Add(InPath, Index);
+		return Index;
+	}
+};
+
+/** Gives file local indices to the names of a name table, the empty name staying at index 0 */
+struct FNameWriter
+{
+	explicit FNameWriter(const FFriendshipperNameTable& InTable)
+		: Table(InTable)
+	{
+		Names.AddDefaulted();
+		Indices.Add(0, 0);
+	}
+
+	uint16 Add(const uint16 InIndex)
+	{
+		if (const uint16* Found = Indices.Find(InIndex))
+		{
+			return *Found;
+		}
+		const uint16 Index = static_cast<uint16>(Names.Add(Table.Get(InIndex)));
+		Indices.Add(InIndex, Index);
+		return Index;
+	}
+
+	const FFriendshipperNameTable& Table;
+	TMap<uint16, uint16> Indices;
+	TArray<FString> Names;
+};
+
+/** Read an element count, checking that the remaining data can hold that many elements of at least InMinSize bytes */
+bool ReadCount(FArchive& Ar, const int64 InMinSize, int32& OutNum)
+{
+	Ar << OutNum;
+	return !Ar.IsError() && OutNum >= 0 && OutNum * InMinSize <= Ar.TotalSize() - Ar.Tell();
+}
+
+bool ReadNames(FArchive& Ar, FFriendshipperNameTable& InTable, TArray<uint16>& OutIndices)
+{
+	int32 Num = 0;
+	if (!ReadCount(Ar, sizeof(int32), Num))
+	{
+		return false;
+	}
+
+	OutIndices.SetNumUninitialized(Num);
+	for (int32 Index = 0; Index < Num; ++Index)
+	{
+		FString Name;
+		Ar << Name;
+		OutIndices[Index] = InTable.Intern(Name);
+	}
+	return !Ar.IsError();
+}
+}
+
+namespace FriendshipperStateCacheFile
+{
+FString GetDefaultPath()
+{
+	return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Friendshipper"), TEXT("StateCache.bin"));
+}
+
+bool Save(const FString& InFilename, const FFriendshipperSavedStates& InStates)
+{
+	FPathWriter PathWriter;
+	FNameWriter LockUsers(FFriendshipperNameTable::LockUsers());
+	FNameWriter Branches(FFriendshipperNameTable::Branches());
+
+	TArray<int32> PathIndices;
+	PathIndices.Reserve(InStates.Paths.Num());
+	for (const FFriendshipperPathId Path : InStates.Paths)
+	{
+		PathIndices.Add(PathWriter.Add(Path));
+	}
+
+	struct FStateRecord
+	{
+		int32 Path;
+		uint8 FileAndTree;
+		uint8 LockAndRemote;
+		uint16 LockUser;
+		uint16 HeadBranch;
+	};
+	TArray<FStateRecord> StateRecords;
+	StateRecords.Reserve(InStates.States.Num());
+	for (const TPair<FFriendshipperPathId, FFriendshipperState>& Pair : InStates.States)
+	{
+		const FFriendshipperState& State = Pair.Value;
+		FStateRecord& Record = StateRecords.AddDefaulted_GetRef();
+		Record.Path = PathWriter.Add(Pair.Key);
+		Record.FileAndTree = static_cast<uint8>(State.FileState) | static_cast<uint8>(State.TreeState) << 4;
+		Record.LockAndRemote = static_cast<uint8>(State.LockState) | static_cast<uint8>(State.RemoteState) << 4;
+		Record.LockUser = LockUsers.Add(State.LockUserIndex);
+		Record.HeadBranch = Branches.Add(State.HeadBranchIndex);
+	}
+
+	TArray<uint8> Bytes;
+	FMemoryWriter Writer(Bytes);
+
+	uint32 Magic = FileMagic;
+	uint32 Version = FileVersion;
+	FString RepositoryRoot = InStates.RepositoryRoot;
+	FString LastUpdated = InStates.LastUpdated;
+	FString CommitHeadOrigin = InStates.CommitHeadOrigin;
+	Writer << Magic << Version << RepositoryRoot << LastUpdated << CommitHeadOrigin;
+	Writer << LockUsers.Names << Branches.Names;
+
+	int32 NumNodes = PathWriter.Names.Num();
+	Writer << NumNodes;
+	for (int32 Index = 0; Index < NumNodes; ++Index)
+	{
+		Writer << PathWriter.Parents[Index] << PathWriter.Names[Index];
+	}
+
+	Writer << PathIndices;
+
+	int32 NumStates = StateRecords.Num();
+	Writer << NumStates;
+	for (FStateRecord& Record : StateRecords)
+	{
+		Writer << Record.Path << Record.FileAndTree << Record.LockAndRemote << Record.LockUser << Record.HeadBranch;
+	}
+
+	// Never leave a partially written file behind, a crash while saving keeps the previous one
+	const FString TempFilename = InFilename + TEXT(".tmp");
+	if (!FFileHelper::SaveArrayToFile(Bytes, *TempFilename) || !IFileManager::Get().Move(*InFilename, *TempFilename, true, true))
+	{
+		UE_LOG(LogSourceControl, Warning, TEXT("Failed to save the state cache to '%s'"), *InFilename);
+		IFileManager::Get().Delete(*TempFilename, false, false, true);
+		return false;
+	}
+	return true;
+}
+
+bool Load(const FString& InFilename, FFriendshipperSavedStates& OutStates)
+{
+	// Map the file when the platform allows it, the parsing reads it once from start to end
+	TUniquePtr<IMappedFileHandle> MappedFile(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*InFilename));
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	if (MappedFile.IsValid() && MappedFile->GetFileSize() > 0)
+	{
+		MappedRegion.Reset(MappedFile->MapRegion());
+	}
+
+	TArray<uint8> Buffer;
+	FMemoryView Data;
+	if (MappedRegion.IsValid())
+	{
+		Data = FMemoryView(MappedRegion->GetMappedPtr(), MappedRegion->GetMappedSize());
+	}
+	else if (FFileHelper::LoadFileToArray(Buffer, *InFilename, FILEREAD_Silent))
+	{
+		Data = MakeMemoryView(Buffer);
+	}
+	else
+	{
+		return false;
+	}
+
+	FMemoryReaderView Reader(Data);
+
+	uint32 Magic = 0;
+	uint32 Version = 0;
+	Reader << Magic << Version;
+	if (Reader.IsError() || Magic != FileMagic || Version != FileVersion)
+	{
+		UE_LOG(LogSourceControl, Log, TEXT("Ignoring outdated state cache '%s'"), *InFilename);
+		return false;
+	}
+
+	Reader << OutStates.RepositoryRoot << OutStates.LastUpdated << OutStates.CommitHeadOrigin;
+
+	TArray<uint16> LockUsers;
+	TArray<uint16> Branches;
+	if (!ReadNames(Reader, FFriendshipperNameTable::LockUsers(), LockUsers) || !ReadNames(Reader, FFriendshipperNameTable::Branches(), Branches))
+	{
+		return false;
+	}
+
+	int32 NumNodes = 0;
+	if (!ReadCount(Reader, 2 * sizeof(int32), NumNodes))
+	{
+		return false;
+	}
+
+	FFriendshipperPathTable& PathTable = FFriendshipperPathTable::Get();
+	TArray<FFriendshipperPathId> Ids;
+	Ids.SetNumUninitialized(NumNodes);
+	for (int32 Index = 0; Index < NumNodes; ++Index)
+	{
+		int32 Parent = INDEX_NONE;
+		FString Name;
+		Reader << Parent << Name;
+		if (Reader.IsError() || Parent < INDEX_NONE || Parent >= Index || Name.IsEmpty())
+		{
+			return false;
+		}
+		Ids[Index] = PathTable.InternChild(Parent == INDEX_NONE ? FFriendshipperPathId() : Ids[Parent], Name);
+	}
+
+	int32 NumPaths = 0;
+	if (!ReadCount(Reader, sizeof(int32), NumPaths))
+	{
+		return false;
+	}
+	OutStates.Paths.Reserve(NumPaths);
+	for (int32 Index = 0; Index < NumPaths; ++Index)
+	{
+		int32 Path = 0;
+		Reader << Path;
+		if (!Ids.IsValidIndex(Path))
+		{
+			return false;
+		}
+		OutStates.Paths.Add(Ids[Path]);
+	}
+
+	int32 NumStates = 0;
+	if (!ReadCount(Reader, sizeof(int32) + 2 * sizeof(uint8) + 2 * sizeof(uint16), NumStates))
+	{
+		return false;
+	}
+	OutStates.States.Reserve(NumStates);
+	for (int32 Index = 0; Index < NumStates; ++Index)
+	{
+		int32 Path = 0;
+		uint8 FileAndTree = 0;
+		uint8 LockAndRemote = 0;
+		uint16 LockUser = 0;
+		uint16 HeadBranch = 0;
+		Reader << Path << FileAndTree << LockAndRemote << LockUser << HeadBranch;
+		if (!Ids.IsValidIndex(Path) || !LockUsers.IsValidIndex(LockUser) || !Branches.IsValidIndex(HeadBranch))
+		{
+			return false;
+		}
+
+		FFriendshipperState& State = OutStates.States.Add(Ids[Path]);
+		State.FileState = static_cast<EFileState::Type>(FileAndTree & 0xF);
+		State.TreeState = static_cast<ETreeState::Type>(FileAndTree >> 4);
+		State.LockState = static_cast<ELockState::Type>(LockAndRemote & 0xF);
+		State.RemoteState = static_cast<ERemoteState::Type>(LockAndRemote >> 4);
+		State.LockUserIndex = LockUsers[LockUser];
+		State.HeadBranchIndex = Branches[HeadBranch];
+	}
+
+	return !Reader.IsError();
+}
+}
@@ -0,0 +1,40 @@
+// Copyright The Believer Company. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "FriendshipperPathTable.h"
+#include "FriendshipperSourceControlState.h"
+
+/** What is persisted between editor sessions: the tracked files and the states last applied from a status */
+struct FFriendshipperSavedStates
+{
+	/** Repository the states belong to, a file saved for another one is never loaded */
+	FString RepositoryRoot;
+
+	/** Status the states were computed from, see FFriendshipperRepoStatusIndex */
+	FString LastUpdated;
+	FString CommitHeadOrigin;
+
+	TSet<FFriendshipperPathId> Paths;
+	TMap<FFriendshipperPathId, FFriendshipperState> States;
+};
+
+/**
+ * Compact binary file holding FFriendshipperSavedStates, so that the editor can show the last known states right away
+ * on startup instead of waiting for git and the Friendshipper status.
+ *
+ * Paths are stored as a tree of components (each with the index of its parent), sharing prefixes like the path
+ * table does, and lock user and branch names are stored once. The file is memory mapped when loading.
+ */
+namespace FriendshipperStateCacheFile
+{
+	/** Default location of the file, under the project Saved directory */
+	FString GetDefaultPath();
+
+	/** Write the states to a temporary file next to InFilename, then move it in place */
+	bool Save(const FString& InFilename, const FFriendshipperSavedStates& InStates);
+
+	/** Read states saved by Save. Fails on a missing, truncated or outdated file. */
+	bool Load(const FString& InFilename, FFriendshipperSavedStates& OutStates);
+}